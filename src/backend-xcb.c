@@ -0,0 +1,714 @@
+/*
+ * backend-xcb.c - XCB backend for xrandrwait
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <xcb/xcb.h>
+#include <xcb/randr.h>
+#include "backend.h"
+#include "ring.h"
+
+struct context {
+	xcb_connection_t *conn;
+	int index;
+	int nscreens;
+	xcb_window_t roots[MAX_SCREENS];
+	uint8_t event_base;
+
+	/* Event taken from xcb's queue by context_pending() */
+	xcb_generic_event_t *queued;
+
+	/* Set while a batch of events is being dispatched */
+	int batch;
+
+	/* Atom of the EDID property, once an output has one */
+	xcb_atom_t edid;
+
+	/* Set once the version has been sent */
+	int versioned;
+
+	/* Events of the current batch */
+	struct event_ring ring;
+};
+
+static void find_roots(struct context *ctx)
+{
+	xcb_screen_iterator_t iter;
+
+	iter = xcb_setup_roots_iterator(xcb_get_setup(ctx->conn));
+
+	for (; iter.rem && ctx->nscreens < MAX_SCREENS; xcb_screen_next(&iter)) {
+		ctx->roots[ctx->nscreens++] = iter.data->root;
+	}
+}
+
+static int screen_of(struct context *ctx, xcb_window_t root)
+{
+	int i;
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		if (ctx->roots[i] == root) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Announce the version that we understand before the first request for
+ * resources. Selecting events doesn't depend on it, so one-shot waits
+ * that never look at the resources don't send it at all, and nothing
+ * depends on the reply, so it is never waited for.
+ */
+static void announce_version(struct context *ctx)
+{
+	if (!ctx->versioned) {
+		xcb_discard_reply(ctx->conn,
+				  xcb_randr_query_version(ctx->conn,
+							  XCB_RANDR_MAJOR_VERSION,
+							  XCB_RANDR_MINOR_VERSION).sequence);
+		ctx->versioned = 1;
+	}
+}
+
+static int context_init_xrr(struct context *ctx, int event_mask)
+{
+	const xcb_query_extension_reply_t *ext;
+	int i;
+
+	ext = xcb_get_extension_data(ctx->conn, &xcb_randr_id);
+
+	if (!ext || !ext->present) {
+		return -ENOTSUP;
+	}
+
+	ctx->event_base = ext->first_event;
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		xcb_randr_select_input(ctx->conn, ctx->roots[i], event_mask);
+	}
+
+	xcb_flush(ctx->conn);
+
+	return 0;
+}
+
+int context_close(struct context *ctx)
+{
+	if (!ctx) {
+		return -EINVAL;
+	}
+
+	free(ctx->queued);
+
+	if (ctx->conn) {
+		xcb_disconnect(ctx->conn);
+	}
+
+	free(ctx);
+
+	return 0;
+}
+
+int context_open(struct context **ctx, int index, const char *name, int event_mask)
+{
+	struct context *c;
+	int err;
+
+	if (!(c = calloc(1, sizeof(*c)))) {
+		return -ENOMEM;
+	}
+
+	c->conn = xcb_connect(name, NULL);
+	c->index = index;
+	event_ring_init(&c->ring);
+
+	if (xcb_connection_has_error(c->conn)) {
+		DBG(fprintf(stderr, "Could not open display\n"));
+		context_close(c);
+		return -EIO;
+	}
+
+	/* Send the extension query before walking the setup, rather than after */
+	xcb_prefetch_extension_data(c->conn, &xcb_randr_id);
+	find_roots(c);
+
+	if (!c->nscreens) {
+		context_close(c);
+		return -ENODEV;
+	}
+
+	if ((err = context_init_xrr(c, event_mask)) < 0) {
+		DBG(fprintf(stderr, "Could not initialize XRandR extension\n"));
+		context_close(c);
+	} else {
+		*ctx = c;
+	}
+
+	return err;
+}
+
+int context_screens(struct context *ctx)
+{
+	return ctx->nscreens;
+}
+
+int context_fd(struct context *ctx)
+{
+	return xcb_get_file_descriptor(ctx->conn);
+}
+
+int context_sync(struct context *ctx)
+{
+	xcb_get_input_focus_reply_t *reply;
+
+	/* Any request with a reply will do, and this one is cheap */
+	reply = xcb_get_input_focus_reply(ctx->conn, xcb_get_input_focus(ctx->conn), NULL);
+
+	if (!reply) {
+		return -EIO;
+	}
+
+	free(reply);
+
+	return 0;
+}
+
+int context_pending(struct context *ctx)
+{
+	xcb_flush(ctx->conn);
+
+	if (!ctx->queued) {
+		ctx->queued = xcb_poll_for_queued_event(ctx->conn);
+	}
+
+	/* Let context_next_event() report a lost connection */
+	return ctx->queued != NULL || !event_ring_empty(&ctx->ring) ||
+	       xcb_connection_has_error(ctx->conn);
+}
+
+static void decode_screen_change_event(struct event *dst, xcb_randr_screen_change_notify_event_t *src)
+{
+	dst->type = EVENT_SCREEN_CHANGE;
+	dst->u.screen.timestamp = src->timestamp;
+	dst->u.screen.config_timestamp = src->config_timestamp;
+	dst->u.screen.width = src->width;
+	dst->u.screen.height = src->height;
+	dst->u.screen.mwidth = src->mwidth;
+	dst->u.screen.mheight = src->mheight;
+	dst->u.screen.rotation = src->rotation;
+}
+
+/*
+ * RRNotify decoders return the window that the event was selected on, so
+ * that the screen can be told from it.
+ */
+static xcb_window_t decode_output_change_event(struct event *dst,
+					       const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_output_change_t *src = &u->oc;
+
+	dst->type = EVENT_OUTPUT_CHANGE;
+	dst->u.output.output = src->output;
+	dst->u.output.crtc = src->crtc;
+	dst->u.output.mode = src->mode;
+	dst->u.output.rotation = src->rotation;
+	dst->u.output.connection = src->connection;
+
+	return src->window;
+}
+
+static xcb_window_t decode_crtc_change_event(struct event *dst,
+					     const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_crtc_change_t *src = &u->cc;
+
+	dst->type = EVENT_CRTC_CHANGE;
+	dst->u.crtc.crtc = src->crtc;
+	dst->u.crtc.mode = src->mode;
+	dst->u.crtc.rotation = src->rotation;
+	dst->u.crtc.x = src->x;
+	dst->u.crtc.y = src->y;
+	dst->u.crtc.width = src->width;
+	dst->u.crtc.height = src->height;
+
+	return src->window;
+}
+
+static xcb_window_t decode_output_property_event(struct event *dst,
+						 const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_output_property_t *src = &u->op;
+
+	dst->type = EVENT_OUTPUT_PROPERTY;
+	dst->u.property.xid = src->output;
+	dst->u.property.atom = src->atom;
+	dst->u.property.timestamp = src->timestamp;
+	dst->u.property.state = src->status;
+
+	return src->window;
+}
+
+static xcb_window_t decode_provider_change_event(struct event *dst,
+						 const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_provider_change_t *src = &u->pc;
+
+	dst->type = EVENT_PROVIDER_CHANGE;
+	dst->u.provider.provider = src->provider;
+	dst->u.provider.timestamp = src->timestamp;
+
+	return src->window;
+}
+
+static xcb_window_t decode_provider_property_event(struct event *dst,
+						   const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_provider_property_t *src = &u->pp;
+
+	dst->type = EVENT_PROVIDER_PROPERTY;
+	dst->u.property.xid = src->provider;
+	dst->u.property.atom = src->atom;
+	dst->u.property.timestamp = src->timestamp;
+	dst->u.property.state = src->state;
+
+	return src->window;
+}
+
+static xcb_window_t decode_resource_change_event(struct event *dst,
+						 const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_resource_change_t *src = &u->rc;
+
+	dst->type = EVENT_RESOURCE_CHANGE;
+	dst->u.resource.timestamp = src->timestamp;
+
+	return src->window;
+}
+
+static xcb_window_t decode_lease_event(struct event *dst,
+				       const xcb_randr_notify_data_t *u)
+{
+	const xcb_randr_lease_notify_t *src = &u->lc;
+
+	dst->type = EVENT_LEASE;
+	dst->u.lease.lease = src->lease;
+	dst->u.lease.timestamp = src->timestamp;
+	dst->u.lease.created = src->created;
+
+	return src->window;
+}
+
+/* Decoders for RRNotify events, indexed by subcode */
+static xcb_window_t (*const notify_decoders[])(struct event*,
+					       const xcb_randr_notify_data_t*) = {
+	[XCB_RANDR_NOTIFY_CRTC_CHANGE]       = decode_crtc_change_event,
+	[XCB_RANDR_NOTIFY_OUTPUT_CHANGE]     = decode_output_change_event,
+	[XCB_RANDR_NOTIFY_OUTPUT_PROPERTY]   = decode_output_property_event,
+	[XCB_RANDR_NOTIFY_PROVIDER_CHANGE]   = decode_provider_change_event,
+	[XCB_RANDR_NOTIFY_PROVIDER_PROPERTY] = decode_provider_property_event,
+	[XCB_RANDR_NOTIFY_RESOURCE_CHANGE]   = decode_resource_change_event,
+	[XCB_RANDR_NOTIFY_LEASE]             = decode_lease_event
+};
+
+static void decode_event(struct context *ctx, struct event *event, xcb_generic_event_t *xev)
+{
+	event->type = EVENT_OTHER;
+	event->display = ctx->index;
+	event->screen = 0;
+
+	switch ((xev->response_type & ~0x80) - ctx->event_base) {
+	case XCB_RANDR_SCREEN_CHANGE_NOTIFY: {
+		xcb_randr_screen_change_notify_event_t *sc;
+
+		sc = (xcb_randr_screen_change_notify_event_t*)xev;
+		event->screen = screen_of(ctx, sc->root);
+		decode_screen_change_event(event, sc);
+		break;
+	}
+
+	case XCB_RANDR_NOTIFY: {
+		xcb_randr_notify_event_t *notify = (xcb_randr_notify_event_t*)xev;
+		xcb_window_t window;
+
+		if (notify->subCode < ARRAY_SIZE(notify_decoders) &&
+		    notify_decoders[notify->subCode]) {
+			window = notify_decoders[notify->subCode](event, &notify->u);
+			event->screen = screen_of(ctx, window);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+int context_next_event(struct context *ctx, struct event *event)
+{
+	xcb_generic_event_t *xev;
+
+	/*
+	 * Only the first event of a batch may cause the socket to be read.
+	 * Everything that xcb has queued is then decoded into the ring, so
+	 * that xcb's buffers are released right away, and the batch ends
+	 * when the ring runs dry. If more events are queued than the ring
+	 * holds, the oldest ones are dropped.
+	 */
+	if (event_ring_empty(&ctx->ring)) {
+		if (ctx->batch) {
+			ctx->batch = 0;
+			return xcb_connection_has_error(ctx->conn) ? -EIO : 0;
+		}
+
+		if (ctx->queued) {
+			xev = ctx->queued;
+			ctx->queued = NULL;
+		} else if (!(xev = xcb_poll_for_event(ctx->conn))) {
+			return xcb_connection_has_error(ctx->conn) ? -EIO : 0;
+		}
+
+		do {
+			decode_event(ctx, event_ring_put(&ctx->ring), xev);
+			free(xev);
+		} while ((xev = xcb_poll_for_queued_event(ctx->conn)));
+
+		ctx->batch = 1;
+	}
+
+	return event_ring_get(&ctx->ring, event);
+}
+
+unsigned long context_dropped(struct context *ctx)
+{
+	return event_ring_dropped(&ctx->ring);
+}
+
+static void crtc_info_event(struct event *dst, xcb_randr_crtc_t crtc,
+			    xcb_randr_get_crtc_info_reply_t *info)
+{
+	dst->type = EVENT_CRTC_CHANGE;
+	dst->u.crtc.crtc = crtc;
+	dst->u.crtc.mode = info->mode;
+	dst->u.crtc.rotation = info->rotation;
+	dst->u.crtc.x = info->x;
+	dst->u.crtc.y = info->y;
+	dst->u.crtc.width = info->width;
+	dst->u.crtc.height = info->height;
+}
+
+static void output_info_event(struct event *dst, xcb_randr_output_t output,
+			      xcb_randr_get_output_info_reply_t *info,
+			      const struct event *crtcs, int ncrtcs)
+{
+	int i;
+
+	dst->type = EVENT_OUTPUT_CHANGE;
+	dst->u.output.output = output;
+	dst->u.output.crtc = info->crtc;
+	dst->u.output.mode = XCB_NONE;
+	dst->u.output.rotation = RR_Rotate_0;
+	dst->u.output.connection = info->connection;
+
+	/* The mode and rotation of an output are those of its CRTC */
+	for (i = 0; i < ncrtcs; i++) {
+		if (crtcs[i].u.crtc.crtc == info->crtc) {
+			dst->u.output.mode = crtcs[i].u.crtc.mode;
+			dst->u.output.rotation = crtcs[i].u.crtc.rotation;
+			break;
+		}
+	}
+}
+
+static int screen_snapshot(struct context *ctx, int screen, event_cb *cb, void *data)
+{
+	xcb_randr_get_screen_resources_current_reply_t *res;
+	xcb_randr_get_crtc_info_cookie_t *crtc_cookies;
+	xcb_randr_get_output_info_cookie_t *output_cookies;
+	xcb_randr_crtc_t *crtc_ids;
+	xcb_randr_output_t *output_ids;
+	struct event *crtcs;
+	struct event event;
+	int ncrtc, noutput;
+	int ncrtcs;
+	int i;
+
+	announce_version(ctx);
+	res = xcb_randr_get_screen_resources_current_reply(ctx->conn,
+		xcb_randr_get_screen_resources_current(ctx->conn, ctx->roots[screen]), NULL);
+
+	if (!res) {
+		return -EIO;
+	}
+
+	crtc_ids = xcb_randr_get_screen_resources_current_crtcs(res);
+	ncrtc = xcb_randr_get_screen_resources_current_crtcs_length(res);
+	output_ids = xcb_randr_get_screen_resources_current_outputs(res);
+	noutput = xcb_randr_get_screen_resources_current_outputs_length(res);
+
+	crtc_cookies = calloc(ncrtc + 1, sizeof(*crtc_cookies));
+	output_cookies = calloc(noutput + 1, sizeof(*output_cookies));
+	crtcs = calloc(ncrtc + 1, sizeof(*crtcs));
+
+	if (!crtc_cookies || !output_cookies || !crtcs) {
+		free(crtc_cookies);
+		free(output_cookies);
+		free(crtcs);
+		free(res);
+		return -ENOMEM;
+	}
+
+	/* Send all requests before waiting for the first reply */
+	for (i = 0; i < ncrtc; i++) {
+		crtc_cookies[i] = xcb_randr_get_crtc_info(ctx->conn, crtc_ids[i],
+							  res->config_timestamp);
+	}
+
+	for (i = 0; i < noutput; i++) {
+		output_cookies[i] = xcb_randr_get_output_info(ctx->conn, output_ids[i],
+							      res->config_timestamp);
+	}
+
+	for (ncrtcs = i = 0; i < ncrtc; i++) {
+		xcb_randr_get_crtc_info_reply_t *info;
+
+		if ((info = xcb_randr_get_crtc_info_reply(ctx->conn, crtc_cookies[i], NULL))) {
+			crtc_info_event(&crtcs[ncrtcs], crtc_ids[i], info);
+			crtcs[ncrtcs].display = ctx->index;
+			crtcs[ncrtcs].screen = screen;
+			cb(&crtcs[ncrtcs++], data);
+			free(info);
+		}
+	}
+
+	for (i = 0; i < noutput; i++) {
+		xcb_randr_get_output_info_reply_t *info;
+
+		if ((info = xcb_randr_get_output_info_reply(ctx->conn, output_cookies[i], NULL))) {
+			output_info_event(&event, output_ids[i], info, crtcs, ncrtcs);
+			event.display = ctx->index;
+			event.screen = screen;
+			cb(&event, data);
+			free(info);
+		}
+	}
+
+	free(crtcs);
+	free(output_cookies);
+	free(crtc_cookies);
+	free(res);
+
+	return 0;
+}
+
+int context_snapshot(struct context *ctx, event_cb *cb, void *data)
+{
+	int err;
+	int i;
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		if ((err = screen_snapshot(ctx, i, cb, data)) < 0) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int context_modes(struct context *ctx, mode_cb *cb, void *data)
+{
+	xcb_randr_get_screen_resources_current_reply_t *res;
+	xcb_randr_mode_info_t *modes;
+	struct mode_info mode;
+	int nmodes;
+	int screen;
+	int i;
+
+	announce_version(ctx);
+
+	for (screen = 0; screen < ctx->nscreens; screen++) {
+		res = xcb_randr_get_screen_resources_current_reply(ctx->conn,
+			xcb_randr_get_screen_resources_current(ctx->conn, ctx->roots[screen]), NULL);
+
+		if (!res) {
+			return -EIO;
+		}
+
+		modes = xcb_randr_get_screen_resources_current_modes(res);
+		nmodes = xcb_randr_get_screen_resources_current_modes_length(res);
+
+		for (i = 0; i < nmodes; i++) {
+			mode.id = modes[i].id;
+			mode.width = modes[i].width;
+			mode.height = modes[i].height;
+			mode.dot_clock = modes[i].dot_clock;
+			mode.htotal = modes[i].htotal;
+			mode.vtotal = modes[i].vtotal;
+			mode.flags = modes[i].mode_flags;
+			cb(&mode, data);
+		}
+
+		free(res);
+	}
+
+	return 0;
+}
+
+int context_output_name(struct context *ctx, uint32_t output, char *name, size_t size)
+{
+	xcb_randr_get_output_info_reply_t *info;
+
+	announce_version(ctx);
+	info = xcb_randr_get_output_info_reply(ctx->conn,
+		xcb_randr_get_output_info(ctx->conn, output, XCB_CURRENT_TIME), NULL);
+
+	if (!info) {
+		return -ENOENT;
+	}
+
+	snprintf(name, size, "%.*s", xcb_randr_get_output_info_name_length(info),
+		 (const char*)xcb_randr_get_output_info_name(info));
+	free(info);
+
+	return 0;
+}
+
+int context_atom_name(struct context *ctx, uint32_t atom, char *name, size_t size)
+{
+	xcb_get_atom_name_reply_t *reply;
+
+	reply = xcb_get_atom_name_reply(ctx->conn,
+		xcb_get_atom_name(ctx->conn, atom), NULL);
+
+	if (!reply) {
+		return -ENOENT;
+	}
+
+	snprintf(name, size, "%.*s", xcb_get_atom_name_name_length(reply),
+		 xcb_get_atom_name_name(reply));
+	free(reply);
+
+	return 0;
+}
+
+int context_output_edid(struct context *ctx, uint32_t output, uint8_t *edid, size_t size)
+{
+	xcb_randr_get_output_property_reply_t *prop;
+	xcb_intern_atom_reply_t *atom;
+	size_t len;
+
+	/* Without an EDID on any output, the atom doesn't exist yet */
+	if (!ctx->edid) {
+		atom = xcb_intern_atom_reply(ctx->conn,
+			xcb_intern_atom(ctx->conn, 1, strlen(RR_PROPERTY_RANDR_EDID),
+					RR_PROPERTY_RANDR_EDID), NULL);
+
+		if (!atom) {
+			return -EIO;
+		}
+
+		ctx->edid = atom->atom;
+		free(atom);
+
+		if (!ctx->edid) {
+			return -ENOENT;
+		}
+	}
+
+	announce_version(ctx);
+
+	/* The length is given in 32-bit units */
+	prop = xcb_randr_get_output_property_reply(ctx->conn,
+		xcb_randr_get_output_property(ctx->conn, output, ctx->edid, XCB_ATOM_ANY,
+					      0, (size + 3) / 4, 0, 0), NULL);
+
+	if (!prop) {
+		return -EIO;
+	}
+
+	if (prop->type != XCB_ATOM_INTEGER || prop->format != 8 || !prop->num_items) {
+		free(prop);
+		return -ENOENT;
+	}
+
+	len = xcb_randr_get_output_property_data_length(prop);
+	len = len < size ? len : size;
+	memcpy(edid, xcb_randr_get_output_property_data(prop), len);
+	free(prop);
+
+	return len;
+}
+
+int context_providers(struct context *ctx, provider_cb *cb, void *data)
+{
+	xcb_randr_get_providers_reply_t *res;
+	xcb_randr_get_provider_info_reply_t *info;
+	xcb_randr_provider_t *providers;
+	struct provider_info provider;
+	int nproviders;
+	int screen;
+	int i;
+
+	announce_version(ctx);
+
+	for (screen = 0; screen < ctx->nscreens; screen++) {
+		/* Servers without XRandR 1.4 answer with an error */
+		res = xcb_randr_get_providers_reply(ctx->conn,
+			xcb_randr_get_providers(ctx->conn, ctx->roots[screen]), NULL);
+
+		if (!res) {
+			return 0;
+		}
+
+		providers = xcb_randr_get_providers_providers(res);
+		nproviders = xcb_randr_get_providers_providers_length(res);
+
+		for (i = 0; i < nproviders; i++) {
+			info = xcb_randr_get_provider_info_reply(ctx->conn,
+				xcb_randr_get_provider_info(ctx->conn, providers[i],
+							    XCB_CURRENT_TIME), NULL);
+
+			if (!info) {
+				continue;
+			}
+
+			provider.provider = providers[i];
+			provider.capabilities = info->capabilities;
+			provider.ncrtcs = info->num_crtcs;
+			provider.noutputs = info->num_outputs;
+			provider.nassociated = info->num_associated_providers;
+			snprintf(provider.name, sizeof(provider.name), "%.*s",
+				 xcb_randr_get_provider_info_name_length(info),
+				 xcb_randr_get_provider_info_name(info));
+			free(info);
+
+			cb(&provider, data);
+		}
+
+		free(res);
+	}
+
+	return 0;
+}
@@ -0,0 +1,587 @@
+/*
+ * backend-xlib.c - Xlib backend for xrandrwait
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+#include "backend.h"
+#include "ring.h"
+
+struct context {
+	Display *display;
+	int index;
+	int nscreens;
+	Window roots[MAX_SCREENS];
+	int event_base;
+	int error_base;
+
+	/* Set while a batch of events is being dispatched */
+	int batch;
+
+	/* Set once the connection to the X server is gone */
+	int lost;
+
+	/* Atom of the EDID property, once an output has one */
+	Atom edid;
+
+	/* Events of the current batch */
+	struct event_ring ring;
+};
+
+/*
+ * Xlib's default IO error exit handler exits. It is replaced per display,
+ * so that a lost connection is reported like any other error and the
+ * caller decides what to do about it. The IO error handler itself is
+ * process-wide and left alone, since the library may be used by programs
+ * that install their own; the default one only prints a message.
+ */
+static void io_error_exit_handler(Display *display, void *data)
+{
+	((struct context*)data)->lost = 1;
+}
+
+static int context_init_xrr(struct context *ctx, int event_mask)
+{
+	int i;
+
+	/*
+	 * This is the only round trip. libXrandr doesn't query the version
+	 * until resources are requested, and selecting input doesn't wait
+	 * for the server.
+	 */
+	if (!XRRQueryExtension(ctx->display,
+			       &ctx->event_base,
+			       &ctx->error_base)) {
+		return -ENOTSUP;
+	}
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		XRRSelectInput(ctx->display, ctx->roots[i], event_mask);
+	}
+	
+	return 0;
+}
+
+int context_close(struct context *ctx)
+{
+	if (!ctx) {
+		return -EINVAL;
+	}
+	
+	if (ctx->display) {
+		XCloseDisplay(ctx->display);
+	}
+
+	free(ctx);
+
+	return 0;
+}
+
+int context_open(struct context **ctx, int index, const char *name, int event_mask)
+{
+	struct context *c;
+	int err;
+	int i;
+
+	if (!(c = calloc(1, sizeof(*c)))) {
+		return -ENOMEM;
+	}
+
+	c->display = XOpenDisplay(name);
+	c->index = index;
+	event_ring_init(&c->ring);
+	err = 0;
+
+	if (!c->display) {
+		DBG(fprintf(stderr, "Could not open display\n"));
+		free(c);
+		return -EIO;
+	}
+
+	XSetIOErrorExitHandler(c->display, io_error_exit_handler, c);
+
+	c->nscreens = ScreenCount(c->display);
+
+	if (c->nscreens > MAX_SCREENS) {
+		c->nscreens = MAX_SCREENS;
+	}
+
+	for (i = 0; i < c->nscreens; i++) {
+		c->roots[i] = RootWindow(c->display, i);
+	}
+
+	if ((err = context_init_xrr(c, event_mask)) < 0) {
+		DBG(fprintf(stderr, "Could not initialize XRandR extension\n"));
+		context_close(c);
+	} else {
+		*ctx = c;
+	}
+	
+	return err;
+}
+
+static int screen_of(struct context *ctx, Window root)
+{
+	int i;
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		if (ctx->roots[i] == root) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+int context_screens(struct context *ctx)
+{
+	return ctx->nscreens;
+}
+
+int context_fd(struct context *ctx)
+{
+	return ConnectionNumber(ctx->display);
+}
+
+int context_sync(struct context *ctx)
+{
+	XSync(ctx->display, False);
+
+	return ctx->lost ? -EIO : 0;
+}
+
+int context_pending(struct context *ctx)
+{
+	XFlush(ctx->display);
+
+	/* Let context_next_event() report a lost connection */
+	return ctx->lost || !event_ring_empty(&ctx->ring) || XQLength(ctx->display) > 0;
+}
+
+static void decode_screen_change_event(struct event *dst, XEvent *xev)
+{
+	XRRScreenChangeNotifyEvent *src = (XRRScreenChangeNotifyEvent*)xev;
+
+	/* Keep the screen size that Xlib caches up to date */
+	XRRUpdateConfiguration(xev);
+
+	dst->type = EVENT_SCREEN_CHANGE;
+	dst->u.screen.timestamp = src->timestamp;
+	dst->u.screen.config_timestamp = src->config_timestamp;
+	dst->u.screen.width = src->width;
+	dst->u.screen.height = src->height;
+	dst->u.screen.mwidth = src->mwidth;
+	dst->u.screen.mheight = src->mheight;
+	dst->u.screen.rotation = src->rotation;
+}
+
+static void decode_output_change_event(struct event *dst, XEvent *xev)
+{
+	XRROutputChangeNotifyEvent *src = (XRROutputChangeNotifyEvent*)xev;
+
+	dst->type = EVENT_OUTPUT_CHANGE;
+	dst->u.output.output = src->output;
+	dst->u.output.crtc = src->crtc;
+	dst->u.output.mode = src->mode;
+	dst->u.output.rotation = src->rotation;
+	dst->u.output.connection = src->connection;
+}
+
+static void decode_crtc_change_event(struct event *dst, XEvent *xev)
+{
+	XRRCrtcChangeNotifyEvent *src = (XRRCrtcChangeNotifyEvent*)xev;
+
+	dst->type = EVENT_CRTC_CHANGE;
+	dst->u.crtc.crtc = src->crtc;
+	dst->u.crtc.mode = src->mode;
+	dst->u.crtc.rotation = src->rotation;
+	dst->u.crtc.x = src->x;
+	dst->u.crtc.y = src->y;
+	dst->u.crtc.width = src->width;
+	dst->u.crtc.height = src->height;
+}
+
+static void decode_output_property_event(struct event *dst, XEvent *xev)
+{
+	XRROutputPropertyNotifyEvent *src = (XRROutputPropertyNotifyEvent*)xev;
+
+	dst->type = EVENT_OUTPUT_PROPERTY;
+	dst->u.property.xid = src->output;
+	dst->u.property.atom = src->property;
+	dst->u.property.timestamp = src->timestamp;
+	dst->u.property.state = src->state;
+}
+
+static void decode_provider_change_event(struct event *dst, XEvent *xev)
+{
+	XRRProviderChangeNotifyEvent *src = (XRRProviderChangeNotifyEvent*)xev;
+
+	dst->type = EVENT_PROVIDER_CHANGE;
+	dst->u.provider.provider = src->provider;
+	dst->u.provider.timestamp = src->timestamp;
+}
+
+static void decode_provider_property_event(struct event *dst, XEvent *xev)
+{
+	XRRProviderPropertyNotifyEvent *src = (XRRProviderPropertyNotifyEvent*)xev;
+
+	dst->type = EVENT_PROVIDER_PROPERTY;
+	dst->u.property.xid = src->provider;
+	dst->u.property.atom = src->property;
+	dst->u.property.timestamp = src->timestamp;
+	dst->u.property.state = src->state;
+}
+
+static void decode_resource_change_event(struct event *dst, XEvent *xev)
+{
+	XRRResourceChangeNotifyEvent *src = (XRRResourceChangeNotifyEvent*)xev;
+
+	dst->type = EVENT_RESOURCE_CHANGE;
+	dst->u.resource.timestamp = src->timestamp;
+}
+
+/*
+ * Decoders for RRNotify events, indexed by subtype. Xlib doesn't convert
+ * lease events, so they can't be decoded here.
+ */
+static void (*const notify_decoders[])(struct event*, XEvent*) = {
+	[RRNotify_CrtcChange]       = decode_crtc_change_event,
+	[RRNotify_OutputChange]     = decode_output_change_event,
+	[RRNotify_OutputProperty]   = decode_output_property_event,
+	[RRNotify_ProviderChange]   = decode_provider_change_event,
+	[RRNotify_ProviderProperty] = decode_provider_property_event,
+	[RRNotify_ResourceChange]   = decode_resource_change_event
+};
+
+static void decode_event(struct context *ctx, struct event *event, XEvent *xev)
+{
+	event->type = EVENT_OTHER;
+	event->display = ctx->index;
+	event->screen = screen_of(ctx, xev->xany.window);
+
+	switch (xev->type - ctx->event_base) {
+	case RRScreenChangeNotify:
+		decode_screen_change_event(event, xev);
+		break;
+
+	case RRNotify: {
+		int subtype = ((XRRNotifyEvent*)xev)->subtype;
+
+		if (subtype >= 0 && subtype < ARRAY_SIZE(notify_decoders) &&
+		    notify_decoders[subtype]) {
+			notify_decoders[subtype](event, xev);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+int context_next_event(struct context *ctx, struct event *event)
+{
+	XEvent xev;
+
+	/*
+	 * The socket is read once at the start of a batch, and everything
+	 * that this yields is moved from Xlib's queue into the ring, which
+	 * drops the oldest events if there are more than it holds. Xlib's
+	 * queue is emptied either way, so it can't grow without bounds. The
+	 * batch is dispatched from the ring without any further syscalls,
+	 * and ends when the ring runs dry. Anything that arrives in the
+	 * meantime is picked up after the next poll().
+	 */
+	if (ctx->lost) {
+		return -EIO;
+	}
+
+	if (event_ring_empty(&ctx->ring)) {
+		if (ctx->batch) {
+			ctx->batch = 0;
+			return 0;
+		}
+
+		if (!XQLength(ctx->display) &&
+		    XEventsQueued(ctx->display, QueuedAfterReading) <= 0) {
+			return ctx->lost ? -EIO : 0;
+		}
+
+		while (XQLength(ctx->display) > 0) {
+			XNextEvent(ctx->display, &xev);
+			decode_event(ctx, event_ring_put(&ctx->ring), &xev);
+		}
+
+		ctx->batch = 1;
+	}
+
+	return event_ring_get(&ctx->ring, event);
+}
+
+unsigned long context_dropped(struct context *ctx)
+{
+	return event_ring_dropped(&ctx->ring);
+}
+
+static void crtc_info_event(struct event *dst, RRCrtc crtc, XRRCrtcInfo *info)
+{
+	dst->type = EVENT_CRTC_CHANGE;
+	dst->u.crtc.crtc = crtc;
+	dst->u.crtc.mode = info->mode;
+	dst->u.crtc.rotation = info->rotation;
+	dst->u.crtc.x = info->x;
+	dst->u.crtc.y = info->y;
+	dst->u.crtc.width = info->width;
+	dst->u.crtc.height = info->height;
+}
+
+static void output_info_event(struct event *dst, RROutput output, XRROutputInfo *info,
+			      const struct event *crtcs, int ncrtcs)
+{
+	int i;
+
+	dst->type = EVENT_OUTPUT_CHANGE;
+	dst->u.output.output = output;
+	dst->u.output.crtc = info->crtc;
+	dst->u.output.mode = None;
+	dst->u.output.rotation = RR_Rotate_0;
+	dst->u.output.connection = info->connection;
+
+	/* The mode and rotation of an output are those of its CRTC */
+	for (i = 0; i < ncrtcs; i++) {
+		if (crtcs[i].u.crtc.crtc == info->crtc) {
+			dst->u.output.mode = crtcs[i].u.crtc.mode;
+			dst->u.output.rotation = crtcs[i].u.crtc.rotation;
+			break;
+		}
+	}
+}
+
+static int screen_snapshot(struct context *ctx, int screen, event_cb *cb, void *data)
+{
+	XRRScreenResources *res;
+	struct event *crtcs;
+	struct event event;
+	int ncrtcs;
+	int i;
+
+	if (!(res = XRRGetScreenResourcesCurrent(ctx->display, ctx->roots[screen]))) {
+		return -EIO;
+	}
+
+	if (!(crtcs = calloc(res->ncrtc + 1, sizeof(*crtcs)))) {
+		XRRFreeScreenResources(res);
+		return -ENOMEM;
+	}
+
+	for (ncrtcs = i = 0; i < res->ncrtc; i++) {
+		XRRCrtcInfo *info;
+
+		if ((info = XRRGetCrtcInfo(ctx->display, res, res->crtcs[i]))) {
+			crtc_info_event(&crtcs[ncrtcs], res->crtcs[i], info);
+			crtcs[ncrtcs].display = ctx->index;
+			crtcs[ncrtcs].screen = screen;
+			cb(&crtcs[ncrtcs++], data);
+			XRRFreeCrtcInfo(info);
+		}
+	}
+
+	for (i = 0; i < res->noutput; i++) {
+		XRROutputInfo *info;
+
+		if ((info = XRRGetOutputInfo(ctx->display, res, res->outputs[i]))) {
+			output_info_event(&event, res->outputs[i], info, crtcs, ncrtcs);
+			event.display = ctx->index;
+			event.screen = screen;
+			cb(&event, data);
+			XRRFreeOutputInfo(info);
+		}
+	}
+
+	free(crtcs);
+	XRRFreeScreenResources(res);
+
+	return 0;
+}
+
+int context_snapshot(struct context *ctx, event_cb *cb, void *data)
+{
+	int err;
+	int i;
+
+	for (i = 0; i < ctx->nscreens; i++) {
+		if ((err = screen_snapshot(ctx, i, cb, data)) < 0) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int context_modes(struct context *ctx, mode_cb *cb, void *data)
+{
+	XRRScreenResources *res;
+	struct mode_info mode;
+	int screen;
+	int i;
+
+	for (screen = 0; screen < ctx->nscreens; screen++) {
+		if (!(res = XRRGetScreenResourcesCurrent(ctx->display, ctx->roots[screen]))) {
+			return -EIO;
+		}
+
+		for (i = 0; i < res->nmode; i++) {
+			mode.id = res->modes[i].id;
+			mode.width = res->modes[i].width;
+			mode.height = res->modes[i].height;
+			mode.dot_clock = res->modes[i].dotClock;
+			mode.htotal = res->modes[i].hTotal;
+			mode.vtotal = res->modes[i].vTotal;
+			mode.flags = res->modes[i].modeFlags;
+			cb(&mode, data);
+		}
+
+		XRRFreeScreenResources(res);
+	}
+
+	return 0;
+}
+
+int context_output_name(struct context *ctx, uint32_t output, char *name, size_t size)
+{
+	XRRScreenResources res;
+	XRROutputInfo *info;
+
+	/* XRRGetOutputInfo() only looks at the config timestamp */
+	memset(&res, 0, sizeof(res));
+	res.configTimestamp = CurrentTime;
+
+	if (!(info = XRRGetOutputInfo(ctx->display, &res, output))) {
+		return -ENOENT;
+	}
+
+	snprintf(name, size, "%.*s", info->nameLen, info->name);
+	XRRFreeOutputInfo(info);
+
+	return 0;
+}
+
+int context_atom_name(struct context *ctx, uint32_t atom, char *name, size_t size)
+{
+	char *str;
+
+	if (!(str = XGetAtomName(ctx->display, atom))) {
+		return -ENOENT;
+	}
+
+	snprintf(name, size, "%s", str);
+	XFree(str);
+
+	return 0;
+}
+
+int context_output_edid(struct context *ctx, uint32_t output, uint8_t *edid, size_t size)
+{
+	unsigned long nitems;
+	unsigned long after;
+	unsigned char *prop;
+	Atom type;
+	int format;
+	size_t len;
+
+	/* Without an EDID on any output, the atom doesn't exist yet */
+	if (!ctx->edid &&
+	    !(ctx->edid = XInternAtom(ctx->display, RR_PROPERTY_RANDR_EDID, True))) {
+		return -ENOENT;
+	}
+
+	/* The length is given in 32-bit units */
+	if (XRRGetOutputProperty(ctx->display, output, ctx->edid, 0, (size + 3) / 4,
+				 False, False, AnyPropertyType, &type, &format,
+				 &nitems, &after, &prop) != Success) {
+		return -EIO;
+	}
+
+	if (type != XA_INTEGER || format != 8 || !nitems) {
+		XFree(prop);
+		return -ENOENT;
+	}
+
+	len = nitems < size ? nitems : size;
+	memcpy(edid, prop, len);
+	XFree(prop);
+
+	return len;
+}
+
+int context_providers(struct context *ctx, provider_cb *cb, void *data)
+{
+	XRRProviderResources *res;
+	XRRProviderInfo *info;
+	XRRScreenResources sres;
+	struct provider_info provider;
+	int major;
+	int minor;
+	int screen;
+	int i;
+
+	/* Older servers would answer the request with an error */
+	if (!XRRQueryVersion(ctx->display, &major, &minor) ||
+	    major < 1 || (major == 1 && minor < 4)) {
+		return 0;
+	}
+
+	/* XRRGetProviderInfo() only looks at the config timestamp */
+	memset(&sres, 0, sizeof(sres));
+	sres.configTimestamp = CurrentTime;
+
+	for (screen = 0; screen < ctx->nscreens; screen++) {
+		if (!(res = XRRGetProviderResources(ctx->display, ctx->roots[screen]))) {
+			return -EIO;
+		}
+
+		for (i = 0; i < res->nproviders; i++) {
+			if (!(info = XRRGetProviderInfo(ctx->display, &sres, res->providers[i]))) {
+				continue;
+			}
+
+			provider.provider = res->providers[i];
+			provider.capabilities = info->capabilities;
+			provider.ncrtcs = info->ncrtcs;
+			provider.noutputs = info->noutputs;
+			provider.nassociated = info->nassociatedproviders;
+			snprintf(provider.name, sizeof(provider.name), "%.*s",
+				 info->nameLen, info->name);
+			XRRFreeProviderInfo(info);
+
+			cb(&provider, data);
+		}
+
+		XRRFreeProviderResources(res);
+	}
+
+	return 0;
+}
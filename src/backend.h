@@ -0,0 +1,225 @@
+/*
+ * backend.h - Interface between xrandrwait and the X protocol library
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <X11/extensions/randr.h>
+
+#if DEBUG
+#define DBG(hoge) do { hoge; } while (0)
+#else
+#define DBG(hoge)
+#endif /* DEBUG */
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+
+#define MAX_DISPLAYS 16
+#define MAX_SCREENS 16
+
+enum event_type {
+	EVENT_OTHER = 0,
+	EVENT_SCREEN_CHANGE,
+	EVENT_CRTC_CHANGE,
+	EVENT_OUTPUT_CHANGE,
+	EVENT_OUTPUT_PROPERTY,
+	EVENT_PROVIDER_CHANGE,
+	EVENT_PROVIDER_PROPERTY,
+	EVENT_RESOURCE_CHANGE,
+	EVENT_LEASE,
+	EVENT_TYPES
+};
+
+/*
+ * XRandR event, decoded by the backend. XIDs are stored as they appear
+ * on the wire, so records look the same regardless of the backend.
+ * XIDs are only unique within a display, which is identified by the index
+ * that was passed to context_open().
+ */
+struct event {
+	int type;
+	uint8_t display;
+	uint8_t screen;
+
+	union {
+		struct {
+			uint32_t timestamp;
+			uint32_t config_timestamp;
+			uint16_t width;
+			uint16_t height;
+			uint16_t mwidth;
+			uint16_t mheight;
+			uint16_t rotation;
+		} screen;
+
+		struct {
+			uint32_t crtc;
+			uint32_t mode;
+			uint16_t rotation;
+			int16_t x;
+			int16_t y;
+			uint16_t width;
+			uint16_t height;
+		} crtc;
+
+		struct {
+			uint32_t output;
+			uint32_t crtc;
+			uint32_t mode;
+			uint16_t rotation;
+			uint8_t connection;
+		} output;
+
+		/* Output and provider property events; xid is the owner */
+		struct {
+			uint32_t xid;
+			uint32_t atom;
+			uint32_t timestamp;
+			uint8_t state;
+		} property;
+
+		struct {
+			uint32_t provider;
+			uint32_t timestamp;
+		} provider;
+
+		struct {
+			uint32_t timestamp;
+		} resource;
+
+		struct {
+			uint32_t lease;
+			uint32_t timestamp;
+			uint8_t created;
+		} lease;
+	} u;
+};
+
+/* Timing of a mode, as far as it is needed to describe the mode */
+struct mode_info {
+	uint32_t id;
+	uint16_t width;
+	uint16_t height;
+	uint32_t dot_clock;
+	uint16_t htotal;
+	uint16_t vtotal;
+	uint32_t flags;
+};
+
+#define PROVIDER_NAME_SIZE 32
+
+/*
+ * A provider, usually a GPU, with what it can be used for (a mask of
+ * RR_Capability_*) and the number of resources it has
+ */
+struct provider_info {
+	uint32_t provider;
+	uint32_t capabilities;
+	uint16_t ncrtcs;
+	uint16_t noutputs;
+	uint16_t nassociated;
+	char name[PROVIDER_NAME_SIZE];
+};
+
+struct context;
+
+typedef void (event_cb)(const struct event *event, void *data);
+typedef void (mode_cb)(const struct mode_info *mode, void *data);
+typedef void (provider_cb)(const struct provider_info *provider, void *data);
+
+/*
+ * Connect to the X server of the named display (or $DISPLAY if name is
+ * NULL) and select the XRandR events in event_mask on the root windows of
+ * all of its screens. index is stored in all events from this display.
+ * Returns 0 on success, or a negative error number.
+ */
+int context_open(struct context **ctx, int index, const char *name, int event_mask);
+int context_close(struct context *ctx);
+
+/* Number of screens, i.e. root windows, that events are selected on */
+int context_screens(struct context *ctx);
+
+/* File descriptor of the connection to the X server, for poll() */
+int context_fd(struct context *ctx);
+
+/*
+ * Wait until the server has processed all requests sent so far, such as
+ * the selection of events by context_open(). Events received meanwhile
+ * are queued. Returns 0 on success, or a negative error number if the
+ * connection was lost.
+ */
+int context_sync(struct context *ctx);
+
+/*
+ * Flush outstanding requests and return 1 if there are events that can
+ * be dispatched without reading from the connection, 0 if not.
+ */
+int context_pending(struct context *ctx);
+
+/*
+ * Retrieve the next event without blocking. Returns 1 if an event was
+ * stored in *event, 0 if there are no events left, or a negative error
+ * number if the connection was lost. Events are returned in batches: the
+ * connection is read at most once per batch, and 0 marks the end of it.
+ * A batch is held in a ring of fixed size that is allocated along with
+ * the context; if a batch doesn't fit, its oldest events are dropped.
+ */
+int context_next_event(struct context *ctx, struct event *event);
+
+/* Number of events that were dropped since the last call */
+unsigned long context_dropped(struct context *ctx);
+
+/*
+ * Query the current configuration of all CRTCs and outputs from a single
+ * set of screen resources per screen, and pass it to cb in the form of
+ * synthetic crtc_change and output_change events. Returns 0 on success,
+ * or a negative error number.
+ */
+int context_snapshot(struct context *ctx, event_cb *cb, void *data);
+
+/* Pass all modes of the current screen resources of all screens to cb */
+int context_modes(struct context *ctx, mode_cb *cb, void *data);
+
+/*
+ * Store the name of an output in name. Returns 0 on success, or a negative
+ * error number.
+ */
+int context_output_name(struct context *ctx, uint32_t output, char *name, size_t size);
+
+/* Look up the name of an atom, such as the property of a property event */
+int context_atom_name(struct context *ctx, uint32_t atom, char *name, size_t size);
+
+/*
+ * Store the first size bytes of the EDID of the monitor connected to an
+ * output in edid. Returns the number of bytes stored, or a negative error
+ * number if the output doesn't have an EDID.
+ */
+int context_output_edid(struct context *ctx, uint32_t output, uint8_t *edid, size_t size);
+
+/*
+ * Pass all providers of all screens to cb. Servers that don't support
+ * XRandR 1.4 have no providers. Returns 0 on success, or a negative error
+ * number.
+ */
+int context_providers(struct context *ctx, provider_cb *cb, void *data);
+
+#endif /* BACKEND_H */
@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# bench.sh - Measure how fast xrandrwait handles a trace of events
+# Copyright (C) 2025 Matthias Kruk
+#
+# Xrandrwait is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published
+# by the Free Software Foundation; either version 3, or (at your
+# option) any later version.
+#
+# Xrandrwait is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with xrandrwait; see the file COPYING.  If not, write to the
+# Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+# Boston, MA 02111-1307, USA.
+#
+# Usage: bench.sh XRANDRWAIT [TRACE]
+#
+# Replays TRACE through XRANDRWAIT once for each output format and reports
+# the statistics collected with --stats. If no trace is given, one is
+# recorded from a storm of screen size changes on a temporary Xvfb server,
+# which needs Xvfb and xrandr. The number of changes and the display that
+# Xvfb is started on can be set with BENCH_CHANGES and BENCH_DISPLAY.
+
+xrandrwait="$1"
+trace="$2"
+changes="${BENCH_CHANGES:-1000}"
+display="${BENCH_DISPLAY:-:99}"
+
+tmpdir=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmpdir"' EXIT
+
+record_storm() {
+	if ! command -v Xvfb >/dev/null || ! command -v xrandr >/dev/null; then
+		echo "Xvfb and xrandr are needed to record a trace" 1>&2
+		return 1
+	fi
+
+	Xvfb "$display" -screen 0 1024x768x24 -nolisten tcp >/dev/null 2>&1 &
+	xvfb=$!
+
+	for i in $(seq 50); do
+		if xrandr -d "$display" >/dev/null 2>&1; then
+			break
+		fi
+
+		sleep 0.1
+	done
+
+	"$xrandrwait" --display "$display" --monitor --quiet --record "$trace" \
+		      --event screen_change --event crtc_change --event output_change &
+	recorder=$!
+	sleep 0.5
+
+	for i in $(seq "$changes"); do
+		xrandr -d "$display" --fb 800x600
+		xrandr -d "$display" --fb 1024x768
+	done
+
+	sleep 0.5
+	kill "$recorder" "$xvfb"
+	wait "$recorder" "$xvfb" 2>/dev/null
+
+	return 0
+}
+
+if [ -z "$xrandrwait" ]; then
+	echo "Usage: $0 XRANDRWAIT [TRACE]" 1>&2
+	exit 1
+fi
+
+if [ -z "$trace" ]; then
+	trace="$tmpdir/storm.trace"
+
+	if ! record_storm; then
+		exit 1
+	fi
+fi
+
+for format in text json binary; do
+	if ! "$xrandrwait" --replay "$trace" --monitor --format "$format" \
+	     --stats="$tmpdir/stats" >/dev/null; then
+		echo "Could not replay $trace" 1>&2
+		exit 1
+	fi
+
+	echo "format: $format"
+	sed -e 's/^/  /' "$tmpdir/stats"
+done
+
+exit 0
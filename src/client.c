@@ -0,0 +1,223 @@
+/*
+ * client.c - Receive events from an xrandrwait server
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "backend.h"
+#include "output.h"
+#include "client.h"
+
+#define CLIENT_BUFFER_SIZE 65536
+
+static struct {
+	int fd;
+	char data[CLIENT_BUFFER_SIZE];
+	size_t head;
+	size_t len;
+	char names[OUTPUT_RECORD_MAX];
+	const char *displays[MAX_DISPLAYS];
+	int ndisplays;
+} client = {
+	.fd = -1
+};
+
+/* Read whatever the server has sent. Returns 0 on EOF, -EAGAIN if idle */
+static int client_read(void)
+{
+	ssize_t len;
+
+	if (client.head > 0) {
+		memmove(client.data, client.data + client.head, client.len);
+		client.head = 0;
+	}
+
+	if (client.len == sizeof(client.data)) {
+		return -ENOBUFS;
+	}
+
+	do {
+		len = read(client.fd, client.data + client.len,
+			   sizeof(client.data) - client.len);
+	} while (len < 0 && errno == EINTR);
+
+	if (len < 0) {
+		return -errno;
+	}
+
+	client.len += len;
+
+	return len;
+}
+
+static int parse_hello(const char *data, size_t len)
+{
+	struct record_header header;
+	size_t pos;
+	int i;
+
+	memcpy(&header, data, sizeof(header));
+
+	if (header.type != RECORD_HELLO || header.source > MAX_DISPLAYS ||
+	    len - sizeof(header) > sizeof(client.names)) {
+		return -EPROTO;
+	}
+
+	memcpy(client.names, data + sizeof(header), len - sizeof(header));
+	len -= sizeof(header);
+
+	for (pos = 0, i = 0; i < header.source; i++) {
+		const char *end;
+
+		if (pos >= len || !(end = memchr(client.names + pos, 0, len - pos))) {
+			return -EPROTO;
+		}
+
+		client.displays[i] = client.names + pos;
+		pos = end - client.names + 1;
+	}
+
+	client.ndisplays = header.source;
+
+	return 0;
+}
+
+/* The server sends its greeting right away, so it's fine to block for it */
+static int wait_hello(void)
+{
+	struct record_header header;
+	struct pollfd pfd;
+	int err;
+
+	pfd.fd = client.fd;
+	pfd.events = POLLIN;
+
+	while (client.len < sizeof(header) ||
+	       (memcpy(&header, client.data, sizeof(header)), client.len < header.length)) {
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			return -errno;
+		}
+
+		if ((err = client_read()) == 0) {
+			return -EPIPE;
+		} else if (err < 0 && err != -EAGAIN) {
+			return err;
+		}
+	}
+
+	if (header.length < sizeof(header)) {
+		return -EPROTO;
+	}
+
+	if ((err = parse_hello(client.data, header.length)) < 0) {
+		return err;
+	}
+
+	client.head = header.length;
+	client.len -= header.length;
+
+	return 0;
+}
+
+int client_open(const char *path)
+{
+	struct sockaddr_un addr;
+	int err;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		return -ENAMETOOLONG;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((client.fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -errno;
+	}
+
+	if (connect(client.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+	    fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK) < 0 ||
+	    fcntl(client.fd, F_SETFD, FD_CLOEXEC) < 0) {
+		err = -errno;
+		client_close();
+		return err;
+	}
+
+	if ((err = wait_hello()) < 0) {
+		client_close();
+	}
+
+	return err;
+}
+
+void client_close(void)
+{
+	if (client.fd >= 0) {
+		close(client.fd);
+		client.fd = -1;
+	}
+
+	client.head = 0;
+	client.len = 0;
+	client.ndisplays = 0;
+}
+
+int client_fd(void)
+{
+	return client.fd;
+}
+
+int client_displays(const char *const **displays)
+{
+	*displays = client.displays;
+
+	return client.ndisplays;
+}
+
+int client_next_event(struct event *event)
+{
+	int len;
+	int err;
+
+	while (!(len = output_decode(client.data + client.head, client.len, event))) {
+		if ((err = client_read()) == 0) {
+			return -EIO;
+		} else if (err < 0) {
+			return err == -EAGAIN || err == -EWOULDBLOCK ? 0 : err;
+		}
+	}
+
+	if (len < 0) {
+		return len;
+	}
+
+	client.head += len;
+	client.len -= len;
+
+	return 1;
+}
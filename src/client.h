@@ -0,0 +1,48 @@
+/*
+ * client.h - Receive events from an xrandrwait server
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "backend.h"
+
+/*
+ * Connect to the server listening on the Unix domain socket at path and
+ * wait for its greeting. Returns 0 on success, or a negative error number.
+ */
+int client_open(const char *path);
+void client_close(void);
+
+/* File descriptor of the connection to the server, for poll() */
+int client_fd(void);
+
+/*
+ * Names of the displays watched by the server, indexed by the display
+ * field of events. Returns the number of displays.
+ */
+int client_displays(const char *const **displays);
+
+/*
+ * Same as context_next_event(), but for events received from the server.
+ * Returns -EIO once the server has closed the connection.
+ */
+int client_next_event(struct event *event);
+
+#endif /* CLIENT_H */
@@ -0,0 +1,58 @@
+/*
+ * duration.c - Parsing durations given on the command line
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "duration.h"
+
+int duration_parse(const char *str, long unit, long *ms)
+{
+	long value;
+	char *end;
+
+	errno = 0;
+	value = strtol(str, &end, 10);
+
+	if (errno) {
+		return -errno;
+	}
+
+	if (end == str || value < 0) {
+		return -EINVAL;
+	}
+
+	if (strcmp(end, "ms") == 0) {
+		unit = 1;
+	} else if (strcmp(end, "s") == 0) {
+		unit = 1000;
+	} else if (*end) {
+		return -EINVAL;
+	}
+
+	if (value > LONG_MAX / unit) {
+		return -ERANGE;
+	}
+
+	*ms = value * unit;
+
+	return 0;
+}
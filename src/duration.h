@@ -0,0 +1,31 @@
+/*
+ * duration.h - Parsing durations given on the command line
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DURATION_H
+#define DURATION_H
+
+/*
+ * Parse a duration such as 10, 10s, or 250ms into milliseconds. Numbers
+ * without a unit are multiplied with unit. Returns 0 on success, -EINVAL
+ * if str is not a duration, or -ERANGE if it doesn't fit into a long.
+ */
+int duration_parse(const char *str, long unit, long *ms);
+
+#endif /* DURATION_H */
@@ -0,0 +1,529 @@
+/*
+ * filter.c - Event filters
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "backend.h"
+#include "filter.h"
+#include "names.h"
+#include "output.h"
+
+#define MAX_FILTERS 16
+#define MAX_PREDICATES 8
+
+enum field {
+	FIELD_EVENT = 0,
+	FIELD_OUTPUT,
+	FIELD_CRTC,
+	FIELD_MODE,
+	FIELD_CONNECTION,
+	FIELD_X,
+	FIELD_Y,
+	FIELD_WIDTH,
+	FIELD_HEIGHT,
+	FIELD_ROTATION,
+	FIELD_REFLECTION,
+	FIELD_SCREEN,
+	FIELD_PROVIDER,
+	FIELD_PROPERTY
+};
+
+/* What kind of values a field holds */
+enum field_kind {
+	KIND_XID,
+	KIND_INT,
+	KIND_ENUM
+};
+
+enum op {
+	OP_EQ = 0,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE
+};
+
+static const struct {
+	const char *name;
+	enum field_kind kind;
+} fields[] = {
+	[FIELD_EVENT]      = { "event",      KIND_ENUM },
+	[FIELD_OUTPUT]     = { "output",     KIND_XID },
+	[FIELD_CRTC]       = { "crtc",       KIND_XID },
+	[FIELD_MODE]       = { "mode",       KIND_XID },
+	[FIELD_CONNECTION] = { "connection", KIND_ENUM },
+	[FIELD_X]          = { "x",          KIND_INT },
+	[FIELD_Y]          = { "y",          KIND_INT },
+	[FIELD_WIDTH]      = { "width",      KIND_INT },
+	[FIELD_HEIGHT]     = { "height",     KIND_INT },
+	[FIELD_ROTATION]   = { "rotation",   KIND_ENUM },
+	[FIELD_REFLECTION] = { "reflection", KIND_ENUM },
+	[FIELD_SCREEN]     = { "screen",     KIND_INT },
+	[FIELD_PROVIDER]   = { "provider",   KIND_XID },
+	[FIELD_PROPERTY]   = { "property",   KIND_XID }
+};
+
+/* Longer operators first, so that "<=" isn't taken for "<" */
+static const struct {
+	const char *token;
+	enum op op;
+} ops[] = {
+	{ "!=", OP_NE },
+	{ "<=", OP_LE },
+	{ ">=", OP_GE },
+	{ "=",  OP_EQ },
+	{ "<",  OP_LT },
+	{ ">",  OP_GT }
+};
+
+/*
+ * A predicate compares a field of the event with a value. Values of
+ * enumerated fields are translated to their numeric representation when
+ * the filter is compiled. If name is set, the output or mode is compared
+ * by name instead of XID.
+ */
+struct predicate {
+	uint8_t field;
+	uint8_t op;
+	long value;
+	const char *name;
+};
+
+struct filter {
+	struct predicate predicates[MAX_PREDICATES];
+	int npredicates;
+	char *spec;
+};
+
+static struct filter filters[MAX_FILTERS];
+static int nfilters = 0;
+static int needs_names = 0;
+
+static int parse_enum(enum field field, const char *str, long *value)
+{
+	static const unsigned long rotations[] = {
+		RR_Rotate_0, RR_Rotate_90, RR_Rotate_180, RR_Rotate_270
+	};
+	static const unsigned long reflections[] = {
+		0, RR_Reflect_X, RR_Reflect_Y, RR_Reflect_X | RR_Reflect_Y
+	};
+	int i;
+
+	switch (field) {
+	case FIELD_EVENT:
+		for (i = EVENT_OTHER + 1; i < EVENT_TYPES; i++) {
+			if (strcmp(str, event_name(i)) == 0) {
+				*value = i;
+				return 0;
+			}
+		}
+		break;
+
+	case FIELD_CONNECTION:
+		for (i = RR_Connected; i <= RR_UnknownConnection; i++) {
+			if (strcmp(str, connection_name(i)) == 0) {
+				*value = i;
+				return 0;
+			}
+		}
+		break;
+
+	case FIELD_ROTATION:
+		for (i = 0; i < ARRAY_SIZE(rotations); i++) {
+			if (strcmp(str, rotation_name(rotations[i])) == 0) {
+				*value = rotations[i];
+				return 0;
+			}
+		}
+		break;
+
+	case FIELD_REFLECTION:
+		for (i = 0; i < ARRAY_SIZE(reflections); i++) {
+			if (strcmp(str, reflection_name(reflections[i])) == 0) {
+				*value = reflections[i];
+				return 0;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
+static int parse_predicate(struct predicate *pred, char *str)
+{
+	const char *value;
+	char *end;
+	size_t len;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		len = strlen(fields[i].name);
+
+		if (strncmp(str, fields[i].name, len) == 0) {
+			break;
+		}
+	}
+
+	if (i == ARRAY_SIZE(fields)) {
+		return -EINVAL;
+	}
+
+	pred->field = i;
+	str += len;
+
+	for (i = 0; i < ARRAY_SIZE(ops); i++) {
+		len = strlen(ops[i].token);
+
+		if (strncmp(str, ops[i].token, len) == 0) {
+			break;
+		}
+	}
+
+	if (i == ARRAY_SIZE(ops)) {
+		return -EINVAL;
+	}
+
+	pred->op = ops[i].op;
+	value = str + len;
+	pred->name = NULL;
+
+	switch (fields[pred->field].kind) {
+	case KIND_XID:
+		errno = 0;
+		pred->value = strtoul(value, &end, 0);
+
+		if (!*value || errno || *end) {
+			/* Not a number, so it has to be the name of an output, mode, or property */
+			if (pred->field == FIELD_CRTC || pred->field == FIELD_PROVIDER || !*value) {
+				return -EINVAL;
+			}
+
+			pred->name = value;
+			needs_names = 1;
+		}
+		break;
+
+	case KIND_INT:
+		errno = 0;
+		pred->value = strtol(value, &end, 10);
+
+		if (!*value || errno || *end) {
+			return -EINVAL;
+		}
+		break;
+
+	case KIND_ENUM:
+		if (parse_enum(pred->field, value, &pred->value) < 0) {
+			return -EINVAL;
+		}
+		break;
+	}
+
+	/* Names and enumerations can't be ordered */
+	if ((pred->name || fields[pred->field].kind == KIND_ENUM) &&
+	    pred->op != OP_EQ && pred->op != OP_NE) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int filter_add(const char *spec)
+{
+	struct filter *filter;
+	char *pred;
+	int err;
+
+	if (nfilters == MAX_FILTERS) {
+		return -E2BIG;
+	}
+
+	filter = &filters[nfilters];
+
+	/* The predicates point into the copy, so it's kept until filter_free() */
+	if (!(filter->spec = strdup(spec))) {
+		return -ENOMEM;
+	}
+
+	filter->npredicates = 0;
+
+	for (pred = strtok(filter->spec, ","); pred; pred = strtok(NULL, ",")) {
+		if (filter->npredicates == MAX_PREDICATES) {
+			err = -E2BIG;
+			goto fail;
+		}
+
+		if ((err = parse_predicate(&filter->predicates[filter->npredicates], pred)) < 0) {
+			goto fail;
+		}
+
+		filter->npredicates++;
+	}
+
+	if (!filter->npredicates) {
+		err = -EINVAL;
+		goto fail;
+	}
+
+	nfilters++;
+
+	return 0;
+
+fail:
+	free(filter->spec);
+	filter->spec = NULL;
+
+	return err;
+}
+
+void filter_free(void)
+{
+	int i;
+
+	for (i = 0; i < nfilters; i++) {
+		free(filters[i].spec);
+		filters[i].spec = NULL;
+	}
+
+	nfilters = 0;
+	needs_names = 0;
+}
+
+int filter_needs_names(void)
+{
+	return needs_names;
+}
+
+/*
+ * Extract a field from an event. Returns 1 if the event has the field, and
+ * 0 if it doesn't.
+ */
+static int event_field(const struct event *event, enum field field, long *value)
+{
+	switch (field) {
+	case FIELD_EVENT:
+		*value = event->type;
+		return 1;
+
+	case FIELD_SCREEN:
+		*value = event->screen;
+		return 1;
+
+	case FIELD_OUTPUT:
+		if (event->type == EVENT_OUTPUT_CHANGE) {
+			*value = event->u.output.output;
+			return 1;
+		} else if (event->type == EVENT_OUTPUT_PROPERTY) {
+			*value = event->u.property.xid;
+			return 1;
+		}
+		break;
+
+	case FIELD_PROVIDER:
+		if (event->type == EVENT_PROVIDER_CHANGE) {
+			*value = event->u.provider.provider;
+			return 1;
+		} else if (event->type == EVENT_PROVIDER_PROPERTY) {
+			*value = event->u.property.xid;
+			return 1;
+		}
+		break;
+
+	case FIELD_PROPERTY:
+		if (event->type == EVENT_OUTPUT_PROPERTY ||
+		    event->type == EVENT_PROVIDER_PROPERTY) {
+			*value = event->u.property.atom;
+			return 1;
+		}
+		break;
+
+	case FIELD_CRTC:
+		if (event->type == EVENT_OUTPUT_CHANGE) {
+			*value = event->u.output.crtc;
+			return 1;
+		} else if (event->type == EVENT_CRTC_CHANGE) {
+			*value = event->u.crtc.crtc;
+			return 1;
+		}
+		break;
+
+	case FIELD_MODE:
+		if (event->type == EVENT_OUTPUT_CHANGE) {
+			*value = event->u.output.mode;
+			return 1;
+		} else if (event->type == EVENT_CRTC_CHANGE) {
+			*value = event->u.crtc.mode;
+			return 1;
+		}
+		break;
+
+	case FIELD_CONNECTION:
+		if (event->type == EVENT_OUTPUT_CHANGE) {
+			*value = event->u.output.connection;
+			return 1;
+		}
+		break;
+
+	case FIELD_X:
+	case FIELD_Y:
+		if (event->type == EVENT_CRTC_CHANGE) {
+			*value = field == FIELD_X ? event->u.crtc.x : event->u.crtc.y;
+			return 1;
+		}
+		break;
+
+	case FIELD_WIDTH:
+	case FIELD_HEIGHT:
+		if (event->type == EVENT_CRTC_CHANGE) {
+			*value = field == FIELD_WIDTH ? event->u.crtc.width : event->u.crtc.height;
+			return 1;
+		} else if (event->type == EVENT_SCREEN_CHANGE) {
+			*value = field == FIELD_WIDTH ? event->u.screen.width : event->u.screen.height;
+			return 1;
+		}
+		break;
+
+	case FIELD_ROTATION:
+	case FIELD_REFLECTION:
+		if (event->type == EVENT_CRTC_CHANGE) {
+			*value = event->u.crtc.rotation;
+		} else if (event->type == EVENT_OUTPUT_CHANGE) {
+			*value = event->u.output.rotation;
+		} else if (event->type == EVENT_SCREEN_CHANGE) {
+			*value = event->u.screen.rotation;
+		} else {
+			break;
+		}
+
+		*value &= field == FIELD_ROTATION ? 0xf : (RR_Reflect_X | RR_Reflect_Y);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Modes are named WxH@R.RR, so that modes with the same resolution can be
+ * told apart. A name without a refresh rate matches the mode at any rate.
+ */
+static int mode_cmp(const char *name, const char *pattern)
+{
+	size_t len;
+
+	if (strchr(pattern, '@')) {
+		return strcmp(name, pattern);
+	}
+
+	len = strlen(pattern);
+
+	return strncmp(name, pattern, len) || (name[len] && name[len] != '@');
+}
+
+static int predicate_match(const struct predicate *pred, const struct event *event)
+{
+	long value;
+	int cmp;
+
+	if (!event_field(event, pred->field, &value)) {
+		return 0;
+	}
+
+	if (pred->name) {
+		const char *name;
+
+		switch (pred->field) {
+		case FIELD_OUTPUT:
+			name = names_output(event->display, value);
+			break;
+
+		case FIELD_PROPERTY:
+			name = names_atom(event->display, value);
+			break;
+
+		default:
+			name = names_mode(event->display, value);
+			break;
+		}
+
+		if (!name) {
+			cmp = 1;
+		} else if (pred->field == FIELD_MODE) {
+			cmp = mode_cmp(name, pred->name);
+		} else {
+			cmp = strcmp(name, pred->name);
+		}
+	} else {
+		cmp = value < pred->value ? -1 : value > pred->value;
+	}
+
+	switch (pred->op) {
+	case OP_EQ:
+		return cmp == 0;
+
+	case OP_NE:
+		return cmp != 0;
+
+	case OP_LT:
+		return cmp < 0;
+
+	case OP_LE:
+		return cmp <= 0;
+
+	case OP_GT:
+		return cmp > 0;
+
+	case OP_GE:
+		return cmp >= 0;
+	}
+
+	return 0;
+}
+
+int filter_match(const struct event *event)
+{
+	int i, j;
+
+	if (!nfilters) {
+		return 1;
+	}
+
+	for (i = 0; i < nfilters; i++) {
+		for (j = 0; j < filters[i].npredicates; j++) {
+			if (!predicate_match(&filters[i].predicates[j], event)) {
+				break;
+			}
+		}
+
+		if (j == filters[i].npredicates) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * filter.h - Event filters
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "backend.h"
+
+/*
+ * Compile a filter of the form field=value[,field=value...]. An event
+ * matches the filter if it matches all of its predicates. Returns 0 on
+ * success, or a negative error number if the filter is invalid.
+ */
+int filter_add(const char *spec);
+void filter_free(void);
+
+/* Whether any filter refers to outputs or modes by name */
+int filter_needs_names(void);
+
+/*
+ * Returns 1 if the event matches any of the filters, or if there are no
+ * filters at all, and 0 otherwise.
+ */
+int filter_match(const struct event *event);
+
+#endif /* FILTER_H */
@@ -0,0 +1,509 @@
+/*
+ * hook.c - Run commands in response to events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "backend.h"
+#include "hook.h"
+
+#define HOOK_MAX_ARGS 32
+
+extern char **environ;
+
+struct command {
+	char *buf;
+	char *argv[HOOK_MAX_ARGS + 1];
+
+	/* The worker in persistent mode */
+	pid_t pid;
+	int fd;
+};
+
+/*
+ * A command queued for an event. Jobs are started in the order of seq,
+ * and pid is -1 until then. vars is a single allocation that holds the
+ * pointers as well as the strings they point to.
+ */
+struct job {
+	struct hook_key key;
+	int command;
+	pid_t pid;
+	unsigned long seq;
+	char **vars;
+	int nvars;
+};
+
+static struct command commands[HOOK_MAX_COMMANDS];
+static int ncommands = 0;
+static int hook_persistent = 0;
+static int hook_max_jobs = 1;
+
+/* Slots are free while vars is NULL */
+static struct job jobs[HOOK_QUEUE_SIZE + HOOK_MAX_JOBS];
+static int jobs_running = 0;
+static int jobs_queued = 0;
+static unsigned long jobs_seq = 0;
+static unsigned long jobs_dropped = 0;
+
+int hook_init(const char *const cmds[], int ncmds, int persistent, int max_jobs)
+{
+	int i;
+
+	if (ncmds < 1 || ncmds > HOOK_MAX_COMMANDS ||
+	    max_jobs < 1 || max_jobs > HOOK_MAX_JOBS) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < ncmds; i++) {
+		struct command *cmd = &commands[i];
+		char *arg;
+		int argc;
+
+		cmd->pid = -1;
+		cmd->fd = -1;
+		ncommands = i + 1;
+
+		if (!(cmd->buf = strdup(cmds[i]))) {
+			hook_cleanup();
+			return -ENOMEM;
+		}
+
+		argc = 0;
+
+		for (arg = strtok(cmd->buf, " \t"); arg; arg = strtok(NULL, " \t")) {
+			if (argc == HOOK_MAX_ARGS) {
+				hook_cleanup();
+				return -E2BIG;
+			}
+
+			cmd->argv[argc++] = arg;
+		}
+
+		cmd->argv[argc] = NULL;
+
+		if (!argc) {
+			hook_cleanup();
+			return -EINVAL;
+		}
+	}
+
+	hook_persistent = persistent;
+	hook_max_jobs = max_jobs;
+
+	return 0;
+}
+
+static void hook_wait(struct command *cmd)
+{
+	int status;
+
+	if (cmd->fd >= 0) {
+		close(cmd->fd);
+		cmd->fd = -1;
+	}
+
+	if (cmd->pid < 0) {
+		return;
+	}
+
+	while (waitpid(cmd->pid, &status, 0) < 0 && errno == EINTR);
+	DBG(fprintf(stderr, "Hook %d exited with status %d\n", (int)cmd->pid, status));
+	cmd->pid = -1;
+}
+
+/*
+ * Start a command. If fd is not NULL, the write end of a pipe connected
+ * to its standard input is stored in it.
+ */
+static int hook_spawn(struct command *cmd, char *const envp[], pid_t *pid, int *fd)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	int fds[2] = { -1, -1 };
+	int err;
+
+	posix_spawn_file_actions_init(&actions);
+	posix_spawnattr_init(&attr);
+
+	if (fd) {
+		if (pipe(fds) < 0 ||
+		    fcntl(fds[0], F_SETFD, FD_CLOEXEC) < 0 ||
+		    fcntl(fds[1], F_SETFD, FD_CLOEXEC) < 0) {
+			err = errno;
+			goto cleanup;
+		}
+
+		posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+	}
+
+	err = posix_spawnp(pid, cmd->argv[0], &actions, &attr, cmd->argv, envp);
+
+	if (err) {
+		*pid = -1;
+	} else if (fd) {
+		*fd = fds[1];
+		fds[1] = -1;
+	}
+
+cleanup:
+	if (fds[0] >= 0) {
+		close(fds[0]);
+	}
+
+	if (fds[1] >= 0) {
+		close(fds[1]);
+	}
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (err) {
+		fprintf(stderr, "Could not execute %s: %s\n",
+			cmd->argv[0], strerror(err));
+	}
+
+	return -err;
+}
+
+/*
+ * A worker that went away must not take us down with it, but SIGPIPE is
+ * only ignored while writing to it, so that a reader that closes stdout
+ * still ends xrandrwait.
+ */
+static int write_all(int fd, const char *data, size_t len)
+{
+	struct sigaction ignore;
+	struct sigaction saved;
+	int err = 0;
+
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignore, &saved);
+
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			err = -errno;
+			break;
+		}
+
+		data += written;
+		len -= written;
+	}
+
+	sigaction(SIGPIPE, &saved, NULL);
+
+	return err;
+}
+
+static int hook_feed(struct command *cmd, const char *record, size_t len)
+{
+	int attempt;
+	int err;
+
+	err = 0;
+
+	/* If the worker has exited, start a new one and try once more */
+	for (attempt = 0; attempt < 2; attempt++) {
+		if (cmd->fd < 0) {
+			hook_wait(cmd);
+
+			if ((err = hook_spawn(cmd, environ, &cmd->pid, &cmd->fd)) < 0) {
+				return err;
+			}
+		}
+
+		if (!(err = write_all(cmd->fd, record, len))) {
+			return 0;
+		}
+
+		hook_wait(cmd);
+	}
+
+	return err;
+}
+
+/*
+ * XIDs are unique within a display, so events about the same XID are
+ * about the same object whatever their kind, like changes and property
+ * changes of an output. Events without an XID, such as screen changes,
+ * resource changes, and bursts, are only about the same object if they
+ * are of the same kind.
+ */
+static int same_object(const struct job *a, const struct job *b)
+{
+	return a->command == b->command &&
+	       a->key.display == b->key.display &&
+	       a->key.object == b->key.object &&
+	       (a->key.object || a->key.kind == b->key.kind);
+}
+
+static void job_free(struct job *job)
+{
+	free(job->vars);
+	job->vars = NULL;
+	job->pid = -1;
+}
+
+static int job_start(struct job *job)
+{
+	char **envp;
+	int nenv;
+	int err;
+
+	for (nenv = 0; environ[nenv]; nenv++);
+
+	if (!(envp = malloc((nenv + job->nvars + 1) * sizeof(*envp)))) {
+		return -ENOMEM;
+	}
+
+	/* getenv() returns the first match, so ours have to come first */
+	memcpy(envp, job->vars, job->nvars * sizeof(*envp));
+	memcpy(envp + job->nvars, environ, (nenv + 1) * sizeof(*envp));
+
+	err = hook_spawn(&commands[job->command], envp, &job->pid, NULL);
+
+	free(envp);
+
+	return err;
+}
+
+/*
+ * Start the oldest jobs whose objects have no command running, until
+ * hook_max_jobs are running
+ */
+static void hook_dispatch(void)
+{
+	while (jobs_queued > 0 && jobs_running < hook_max_jobs) {
+		struct job *next = NULL;
+		int i;
+		int j;
+
+		for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+			if (!jobs[i].vars || jobs[i].pid >= 0 ||
+			    (next && next->seq < jobs[i].seq)) {
+				continue;
+			}
+
+			for (j = 0; j < ARRAY_SIZE(jobs); j++) {
+				if (jobs[j].vars && jobs[j].pid >= 0 &&
+				    same_object(&jobs[j], &jobs[i])) {
+					break;
+				}
+			}
+
+			if (j == ARRAY_SIZE(jobs)) {
+				next = &jobs[i];
+			}
+		}
+
+		if (!next) {
+			break;
+		}
+
+		jobs_queued--;
+
+		if (job_start(next) < 0) {
+			job_free(next);
+		} else {
+			jobs_running++;
+		}
+	}
+}
+
+static int hook_queue(const struct hook_key *key, int command,
+		      char *const vars[], int nvars)
+{
+	struct job *slot = NULL;
+	struct job *oldest = NULL;
+	size_t size;
+	char *str;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		struct job *job = &jobs[i];
+
+		if (job->vars && job->pid < 0 && job->command == command &&
+		    memcmp(&job->key, key, sizeof(*key)) == 0) {
+			/* The event at hand supersedes the one the job was queued for */
+			DBG(fprintf(stderr, "Cancelling stale job %lu\n", job->seq));
+			job_free(job);
+			jobs_queued--;
+		}
+
+		if (!job->vars) {
+			slot = slot ? slot : job;
+		} else if (job->pid < 0 && (!oldest || job->seq < oldest->seq)) {
+			oldest = job;
+		}
+	}
+
+	if (jobs_queued == HOOK_QUEUE_SIZE) {
+		DBG(fprintf(stderr, "Queue is full, dropping job %lu\n", oldest->seq));
+		job_free(oldest);
+		jobs_queued--;
+		jobs_dropped++;
+		slot = slot ? slot : oldest;
+	}
+
+	size = (nvars + 1) * sizeof(*slot->vars);
+
+	for (i = 0; i < nvars; i++) {
+		size += strlen(vars[i]) + 1;
+	}
+
+	if (!(slot->vars = malloc(size))) {
+		return -ENOMEM;
+	}
+
+	str = (char*)(slot->vars + nvars + 1);
+
+	for (i = 0; i < nvars; i++) {
+		size_t len = strlen(vars[i]) + 1;
+
+		slot->vars[i] = memcpy(str, vars[i], len);
+		str += len;
+	}
+
+	slot->vars[nvars] = NULL;
+	slot->nvars = nvars;
+	slot->key = *key;
+	slot->command = command;
+	slot->pid = -1;
+	slot->seq = jobs_seq++;
+	jobs_queued++;
+
+	return 0;
+}
+
+int hook_run(const struct hook_key *key, const char *record, size_t len,
+	     char *const vars[], int nvars)
+{
+	int err;
+	int i;
+
+	err = 0;
+
+	for (i = 0; i < ncommands; i++) {
+		int e;
+
+		if (hook_persistent) {
+			e = hook_feed(&commands[i], record, len);
+		} else {
+			e = hook_queue(key, i, vars, nvars);
+		}
+
+		if (e < 0) {
+			err = e;
+		}
+	}
+
+	hook_dispatch();
+
+	return err;
+}
+
+static void job_exited(pid_t pid, int status)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		if (jobs[i].vars && jobs[i].pid == pid) {
+			DBG(fprintf(stderr, "Hook %d exited with status %d\n", (int)pid, status));
+			job_free(&jobs[i]);
+			jobs_running--;
+			break;
+		}
+	}
+}
+
+void hook_reap(void)
+{
+	int status;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(jobs) && jobs_running > 0; i++) {
+		pid_t pid = jobs[i].pid;
+
+		if (jobs[i].vars && pid >= 0 && waitpid(pid, &status, WNOHANG) == pid) {
+			job_exited(pid, status);
+		}
+	}
+
+	hook_dispatch();
+}
+
+void hook_cleanup(void)
+{
+	int status;
+	pid_t pid;
+	int i;
+
+	/* Commands that were queued are still run, just not in the background */
+	hook_dispatch();
+
+	while (jobs_running > 0) {
+		if ((pid = waitpid(-1, &status, 0)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		job_exited(pid, status);
+		hook_dispatch();
+	}
+
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		job_free(&jobs[i]);
+	}
+
+	jobs_running = 0;
+	jobs_queued = 0;
+
+	if (jobs_dropped) {
+		fprintf(stderr, "Dropped %lu commands because too many were queued\n",
+			jobs_dropped);
+	}
+
+	for (i = 0; i < ncommands; i++) {
+		hook_wait(&commands[i]);
+		free(commands[i].buf);
+		commands[i].buf = NULL;
+	}
+
+	ncommands = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * hook.h - Run commands in response to events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOOK_H
+#define HOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOOK_MAX_COMMANDS 8
+#define HOOK_MAX_JOBS 64
+#define HOOK_QUEUE_SIZE 256
+
+/*
+ * Identifies the object that an event is about: an XID, or 0 and the kind
+ * of event for events without one. Commands for the same object, such as
+ * an output, are started in the order of the events, and each one only
+ * after the previous one has exited. A command that hasn't been started
+ * yet is skipped if a newer event of the same kind arrives for the same
+ * object, so detail has to tell apart all events that are still worth
+ * running the command for, such as properties.
+ */
+struct hook_key {
+	int display;
+	int kind;
+	uint32_t object;
+	uint32_t detail;
+};
+
+/*
+ * Set up the ncmds commands to be executed for each event. Commands are
+ * split at whitespace and executed directly, without a shell. If
+ * persistent is set, each command is started once and fed one record per
+ * line on its standard input as they are written to standard output;
+ * otherwise the commands are started for each record, with at most
+ * max_jobs of them running at the same time.
+ */
+int hook_init(const char *const cmds[], int ncmds, int persistent, int max_jobs);
+
+/*
+ * Run the hooks for a record. In persistent mode, the len bytes at record
+ * are written to the commands. Otherwise, the commands are queued to be
+ * started with the nvars strings of the form NAME=VALUE in vars added to
+ * their environment, and those that can run right away are started. If
+ * the queue is full, the oldest command that is waiting is dropped.
+ */
+int hook_run(const struct hook_key *key, const char *record, size_t len,
+	     char *const vars[], int nvars);
+
+/*
+ * Collect the commands that have exited and start the commands that were
+ * waiting for them. Call this whenever SIGCHLD was received.
+ */
+void hook_reap(void);
+
+/*
+ * Run all commands that are still queued, wait for them to finish, and
+ * release all resources
+ */
+void hook_cleanup(void);
+
+#endif /* HOOK_H */
@@ -0,0 +1,646 @@
+/*
+ * monitor.c - Identification of monitors by their EDID
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "backend.h"
+#include "monitor.h"
+#include "xid_table.h"
+
+/*
+ * Only the base block of the EDID is fetched. It holds everything that
+ * identifies a monitor, and extension blocks can be many times its size.
+ */
+#define EDID_BLOCK_SIZE 128
+#define EDID_DESCRIPTORS 54
+#define EDID_DESCRIPTOR_SIZE 18
+
+/* The cache file is extended by this many entries at a time */
+#define CACHE_CHUNK 64
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+struct output_monitor {
+	uint32_t output;
+	int known;
+	uint8_t connection;
+	int valid;
+	struct monitor_info info;
+};
+
+struct display_monitors {
+	struct context *ctx;
+	struct xid_table outputs;
+};
+
+static struct display_monitors displays[MAX_DISPLAYS];
+static int ndisplays;
+
+/*
+ * Shared mapping of the cache file. Entries are only ever appended, under
+ * a write lock, and looked up under a read lock. A file written by another
+ * version is never changed in place, since other instances may still have
+ * it mapped; a new one is renamed over it instead.
+ */
+static struct {
+	int fd;
+	char *data;
+	size_t size;
+} cache = {
+	.fd = -1
+};
+
+static struct monitor_cache_header *cache_header(void)
+{
+	return (struct monitor_cache_header*)cache.data;
+}
+
+static struct monitor_cache_entry *cache_entries(void)
+{
+	return (struct monitor_cache_entry*)(cache.data + sizeof(struct monitor_cache_header));
+}
+
+static size_t cache_capacity(void)
+{
+	return (cache.size - sizeof(struct monitor_cache_header)) /
+		sizeof(struct monitor_cache_entry);
+}
+
+static int cache_valid(void)
+{
+	struct monitor_cache_header *header = cache_header();
+
+	return cache.data && cache.size >= sizeof(*header) &&
+	       memcmp(header->magic, MONITOR_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+	       header->version == MONITOR_CACHE_VERSION &&
+	       header->entry_size == sizeof(struct monitor_cache_entry);
+}
+
+static int cache_lock(int type)
+{
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+
+	while (fcntl(cache.fd, F_SETLKW, &lock) < 0) {
+		if (errno != EINTR) {
+			return -errno;
+		}
+	}
+
+	return 0;
+}
+
+/* Map the whole file, which may have been extended by another instance */
+static int cache_map(void)
+{
+	struct stat st;
+	void *data;
+
+	if (fstat(cache.fd, &st) < 0) {
+		return -errno;
+	}
+
+	if ((size_t)st.st_size == cache.size) {
+		return 0;
+	}
+
+	if (cache.data) {
+		munmap(cache.data, cache.size);
+		cache.data = NULL;
+		cache.size = 0;
+	}
+
+	if (st.st_size < sizeof(struct monitor_cache_header)) {
+		return 0;
+	}
+
+	if ((data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 cache.fd, 0)) == MAP_FAILED) {
+		return -errno;
+	}
+
+	cache.data = data;
+	cache.size = st.st_size;
+
+	return 0;
+}
+
+/* Extend the file by a chunk of entries, allocating the blocks right away */
+static int cache_grow(void)
+{
+	size_t size;
+	int err;
+
+	size = cache.size < sizeof(struct monitor_cache_header) ?
+		sizeof(struct monitor_cache_header) : cache.size;
+	size += CACHE_CHUNK * sizeof(struct monitor_cache_entry);
+
+	if ((err = posix_fallocate(cache.fd, 0, size)) != 0) {
+		return -err;
+	}
+
+	return cache_map();
+}
+
+/* Create a directory and all of its parents, like mkdir -p */
+static int make_dirs(char *path)
+{
+	char *sep = path;
+	int err;
+
+	do {
+		if ((sep = strchr(sep + 1, '/'))) {
+			*sep = 0;
+		}
+
+		err = mkdir(path, 0700) < 0 && errno != EEXIST ? -errno : 0;
+
+		if (sep) {
+			*sep = '/';
+		}
+	} while (!err && sep);
+
+	return err;
+}
+
+static int cache_path(char *path, size_t size)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	int len;
+	int err;
+
+	/* Relative paths in XDG_CACHE_HOME are to be ignored */
+	if (base && base[0] == '/') {
+		len = snprintf(path, size, "%s/xrandrwait", base);
+	} else if (home && home[0] == '/') {
+		len = snprintf(path, size, "%s/.cache/xrandrwait", home);
+	} else {
+		return -ENOENT;
+	}
+
+	if (len < 0 || len + sizeof("/monitors") > size) {
+		return -ENAMETOOLONG;
+	}
+
+	if ((err = make_dirs(path)) < 0) {
+		return err;
+	}
+
+	strcat(path, "/monitors");
+
+	return 0;
+}
+
+static void cache_close(void)
+{
+	if (cache.data) {
+		munmap(cache.data, cache.size);
+		cache.data = NULL;
+		cache.size = 0;
+	}
+
+	if (cache.fd >= 0) {
+		close(cache.fd);
+		cache.fd = -1;
+	}
+}
+
+/*
+ * Replace the cache at path with an empty one. The new file is set up
+ * under a temporary name and renamed over the old one, which stays intact
+ * for anyone who still has it open. The caller holds the lock on the old
+ * file, which is closed on success.
+ */
+static int cache_rebuild(const char *path)
+{
+	struct monitor_cache_header *header;
+	char tmp[PATH_MAX];
+	int old;
+	int err;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid()) >= sizeof(tmp)) {
+		return -ENAMETOOLONG;
+	}
+
+	old = cache.fd;
+
+	if ((cache.fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+		err = -errno;
+		cache.fd = old;
+		return err;
+	}
+
+	if (cache.data) {
+		munmap(cache.data, cache.size);
+		cache.data = NULL;
+		cache.size = 0;
+	}
+
+	if ((err = cache_grow()) == 0) {
+		header = cache_header();
+		memcpy(header->magic, MONITOR_CACHE_MAGIC, sizeof(header->magic));
+		header->version = MONITOR_CACHE_VERSION;
+		header->entry_size = sizeof(struct monitor_cache_entry);
+		header->count = 0;
+
+		if (rename(tmp, path) < 0) {
+			err = -errno;
+		}
+	}
+
+	if (err < 0) {
+		unlink(tmp);
+		cache_close();
+		cache.fd = old;
+		return err;
+	}
+
+	close(old);
+
+	return 0;
+}
+
+/* Open the cache, replacing it if it was written by an incompatible version */
+static int cache_open(void)
+{
+	char path[PATH_MAX];
+	struct stat st_path;
+	struct stat st_fd;
+	int err;
+
+	if ((err = cache_path(path, sizeof(path))) < 0) {
+		return err;
+	}
+
+	/*
+	 * Another instance may have renamed a new cache over the file between
+	 * opening and locking it, in which case the new one is opened.
+	 */
+	do {
+		if (cache.fd >= 0) {
+			close(cache.fd);
+		}
+
+		if ((cache.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) {
+			return -errno;
+		}
+
+		if ((err = cache_lock(F_WRLCK)) < 0) {
+			cache_close();
+			return err;
+		}
+
+		if (fstat(cache.fd, &st_fd) < 0 || stat(path, &st_path) < 0) {
+			err = -errno;
+			cache_close();
+			return err;
+		}
+	} while (st_fd.st_dev != st_path.st_dev || st_fd.st_ino != st_path.st_ino);
+
+	if ((err = cache_map()) == 0 && !cache_valid()) {
+		DBG(fprintf(stderr, "Initializing monitor cache %s\n", path));
+		err = cache_rebuild(path);
+	}
+
+	cache_lock(F_UNLCK);
+
+	if (err < 0) {
+		cache_close();
+	}
+
+	return err;
+}
+
+static struct monitor_cache_entry *cache_find(uint64_t hash)
+{
+	struct monitor_cache_entry *entries;
+	size_t count;
+	size_t i;
+
+	if (!cache.data) {
+		return NULL;
+	}
+
+	count = cache_header()->count;
+	entries = cache_entries();
+
+	/* Entries appended by others are only seen once the file is mapped again */
+	if (count > cache_capacity()) {
+		count = cache_capacity();
+	}
+
+	/* There are rarely more than a handful of monitors */
+	for (i = 0; i < count; i++) {
+		if (entries[i].hash == hash) {
+			return &entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Copy the entry for hash out of the cache, under the lock so that it
+ * isn't read while it is being written. Returns 1 if there is one.
+ */
+static int cache_lookup(uint64_t hash, struct monitor_cache_entry *entry)
+{
+	struct monitor_cache_entry *cached = NULL;
+
+	if (cache.fd < 0 || cache_lock(F_RDLCK) < 0) {
+		return 0;
+	}
+
+	if (cache_map() == 0 && cache_valid() && (cached = cache_find(hash))) {
+		*entry = *cached;
+	}
+
+	cache_lock(F_UNLCK);
+
+	return cached != NULL;
+}
+
+static void cache_store(const struct monitor_cache_entry *entry)
+{
+	struct monitor_cache_header *header;
+	int err;
+
+	if (cache.fd < 0 || cache_lock(F_WRLCK) < 0) {
+		return;
+	}
+
+	if ((err = cache_map()) == 0 && cache_valid() && !cache_find(entry->hash)) {
+		header = cache_header();
+
+		if (header->count >= cache_capacity()) {
+			err = cache_grow();
+			header = cache_header();
+		}
+
+		if (!err) {
+			cache_entries()[header->count] = *entry;
+			header->count++;
+		}
+	}
+
+	if (err < 0) {
+		DBG(fprintf(stderr, "Could not add monitor to cache: %s\n", strerror(-err)));
+	}
+
+	cache_lock(F_UNLCK);
+}
+
+static uint64_t edid_hash(const uint8_t *edid, size_t len)
+{
+	uint64_t hash = FNV_OFFSET;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash = (hash ^ edid[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/*
+ * Copy a string from a display descriptor, which ends with a newline and
+ * is padded with spaces, replacing everything that would need quoting.
+ * Returns the length of the string.
+ */
+static size_t edid_string(char *dst, size_t size, const uint8_t *src, size_t len)
+{
+	size_t end;
+	size_t n;
+	size_t i;
+
+	for (end = 0; end < len && src[end] != '\n'; end++);
+	while (end > 0 && src[end - 1] == ' ') {
+		end--;
+	}
+
+	for (n = 0, i = 0; i < end && n + 1 < size; i++) {
+		dst[n++] = src[i] > ' ' && src[i] <= '~' &&
+			   src[i] != '"' && src[i] != '\\' ? src[i] : '_';
+	}
+
+	memset(dst + n, 0, size - n);
+
+	return n;
+}
+
+/*
+ * Decode vendor, model, and serial number from the base block. The model
+ * and serial number are taken from the display descriptors if there are
+ * any, otherwise the product code and numeric serial number are used.
+ */
+static int edid_parse(const uint8_t *edid, size_t len, struct monitor_cache_entry *entry)
+{
+	static const uint8_t magic[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+	char str[MONITOR_NAME_SIZE];
+	uint32_t serial;
+	uint16_t vendor;
+	int i;
+
+	if (len < EDID_BLOCK_SIZE || memcmp(edid, magic, sizeof(magic)) != 0) {
+		return -EINVAL;
+	}
+
+	/* Three letters of five bits each, starting with A = 1 */
+	vendor = edid[8] << 8 | edid[9];
+
+	for (i = 0; i < 3; i++) {
+		int letter = vendor >> (10 - 5 * i) & 0x1f;
+
+		entry->vendor[i] = letter >= 1 && letter <= 26 ? '@' + letter : '_';
+	}
+
+	entry->vendor[3] = 0;
+
+	snprintf(entry->model, sizeof(entry->model), "%02x%02x", edid[11], edid[10]);
+	serial = edid[12] | edid[13] << 8 | edid[14] << 16 | (uint32_t)edid[15] << 24;
+
+	if (serial) {
+		snprintf(entry->serial, sizeof(entry->serial), "%lu", (unsigned long)serial);
+	} else {
+		snprintf(entry->serial, sizeof(entry->serial), "none");
+	}
+
+	for (i = 0; i < 4; i++) {
+		const uint8_t *desc = edid + EDID_DESCRIPTORS + i * EDID_DESCRIPTOR_SIZE;
+
+		/* Detailed timings start with a non-zero pixel clock */
+		if (desc[0] || desc[1] || desc[2]) {
+			continue;
+		}
+
+		if (edid_string(str, sizeof(str), desc + 5, EDID_DESCRIPTOR_SIZE - 5) == 0) {
+			continue;
+		}
+
+		if (desc[3] == 0xfc) {
+			memcpy(entry->model, str, sizeof(str));
+		} else if (desc[3] == 0xff) {
+			memcpy(entry->serial, str, sizeof(str));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Copy a string from the cache, which may not be terminated, with the
+ * same replacements as a string from the EDID
+ */
+static void cache_string(char *dst, size_t size, const char *src, size_t len)
+{
+	const char *end = memchr(src, 0, len);
+
+	edid_string(dst, size, (const uint8_t*)src, end ? (size_t)(end - src) : len);
+}
+
+static int identify(struct display_monitors *d, uint32_t output, struct monitor_info *info)
+{
+	struct monitor_cache_entry entry;
+	uint8_t edid[EDID_BLOCK_SIZE];
+	int len;
+	int err;
+
+	if ((len = context_output_edid(d->ctx, output, edid, sizeof(edid))) < 0) {
+		return len;
+	}
+
+	memset(&entry, 0, sizeof(entry));
+	entry.hash = edid_hash(edid, len);
+
+	if (!cache_lookup(entry.hash, &entry)) {
+		if ((err = edid_parse(edid, len, &entry)) < 0) {
+			return err;
+		}
+
+		cache_store(&entry);
+	}
+
+	/* The cache may have been written by anyone, so don't trust its strings */
+	snprintf(info->id, sizeof(info->id), "%016llx", (unsigned long long)entry.hash);
+	cache_string(info->vendor, sizeof(info->vendor), entry.vendor, sizeof(entry.vendor));
+	cache_string(info->model, sizeof(info->model), entry.model, sizeof(entry.model));
+	cache_string(info->serial, sizeof(info->serial), entry.serial, sizeof(entry.serial));
+
+	return 0;
+}
+
+int monitor_init(struct context **ctxs, int num_displays)
+{
+	int err;
+
+	if (num_displays <= 0 || num_displays > MAX_DISPLAYS) {
+		return -EINVAL;
+	}
+
+	for (ndisplays = 0; ndisplays < num_displays; ndisplays++) {
+		struct display_monitors *d = &displays[ndisplays];
+
+		if ((err = xid_table_init(&d->outputs, sizeof(struct output_monitor))) < 0) {
+			monitor_free();
+			return err;
+		}
+
+		d->ctx = ctxs[ndisplays];
+	}
+
+	if ((err = cache_open()) < 0) {
+		DBG(fprintf(stderr, "Could not open monitor cache: %s\n", strerror(-err)));
+	}
+
+	return 0;
+}
+
+void monitor_free(void)
+{
+	while (ndisplays > 0) {
+		ndisplays--;
+		xid_table_free(&displays[ndisplays].outputs);
+		displays[ndisplays].ctx = NULL;
+	}
+
+	cache_close();
+}
+
+void monitor_reset(int display, struct context *ctx)
+{
+	if (display < 0 || display >= ndisplays) {
+		return;
+	}
+
+	xid_table_clear(&displays[display].outputs);
+	displays[display].ctx = ctx;
+}
+
+void monitor_update(const struct event *event)
+{
+	struct display_monitors *d;
+	struct output_monitor *m;
+
+	if (event->type != EVENT_OUTPUT_CHANGE || event->display >= ndisplays) {
+		return;
+	}
+
+	d = &displays[event->display];
+
+	if (!(m = xid_table_get(&d->outputs, event->u.output.output))) {
+		return;
+	}
+
+	/* Output change events are also sent when the CRTC or mode changes */
+	if (m->known && m->connection == event->u.output.connection) {
+		return;
+	}
+
+	m->known = 1;
+	m->connection = event->u.output.connection;
+	m->valid = m->connection == RR_Connected &&
+		identify(d, event->u.output.output, &m->info) == 0;
+}
+
+const struct monitor_info *monitor_lookup(int display, uint32_t output)
+{
+	struct output_monitor *m;
+
+	if (display < 0 || display >= ndisplays ||
+	    !(m = xid_table_find(&displays[display].outputs, output)) || !m->valid) {
+		return NULL;
+	}
+
+	return &m->info;
+}
@@ -0,0 +1,86 @@
+/*
+ * monitor.h - Identification of monitors by their EDID
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdint.h>
+#include "backend.h"
+
+#define MONITOR_CACHE_MAGIC "XRWM"
+#define MONITOR_CACHE_VERSION 1
+#define MONITOR_NAME_SIZE 16
+
+/*
+ * What is known about the monitor connected to an output. id is the hash
+ * of its EDID in hexadecimal, which stays the same across reboots, docks,
+ * and connectors. The strings only contain printable characters other
+ * than spaces, quotes, and backslashes, or are "none" if the EDID doesn't
+ * say.
+ */
+struct monitor_info {
+	char id[17];
+	char vendor[4];
+	char model[MONITOR_NAME_SIZE];
+	char serial[MONITOR_NAME_SIZE];
+};
+
+/*
+ * The cache file starts with this header, followed by count entries.
+ * It maps the hashes of all EDIDs that were ever seen to the monitors
+ * they describe, and may be shared by several instances of xrandrwait.
+ */
+struct monitor_cache_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t entry_size;
+	uint32_t count;
+	uint32_t pad;
+};
+
+struct monitor_cache_entry {
+	uint64_t hash;
+	char vendor[4];
+	uint32_t pad;
+	char model[MONITOR_NAME_SIZE];
+	char serial[MONITOR_NAME_SIZE];
+};
+
+/*
+ * Start identifying monitors using the connections in ctxs, one for each
+ * display. If the cache in $XDG_CACHE_HOME can't be used, monitors are
+ * identified without it. Returns 0 on success, or a negative error number.
+ */
+int monitor_init(struct context **ctxs, int num_displays);
+void monitor_free(void);
+
+/* Forget all monitors of a display and use ctx from now on */
+void monitor_reset(int display, struct context *ctx);
+
+/*
+ * Identify the monitor of an output whose connection state changed with
+ * an output change event. The EDID is not fetched for any other events.
+ */
+void monitor_update(const struct event *event);
+
+/* The monitor connected to an output, or NULL if it isn't known */
+const struct monitor_info *monitor_lookup(int display, uint32_t output);
+
+#endif /* MONITOR_H */
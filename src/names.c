@@ -0,0 +1,252 @@
+/*
+ * names.c - Cache of output and mode names
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <errno.h>
+#include "backend.h"
+#include "names.h"
+#include "xid_table.h"
+
+#define NAME_SIZE 32
+
+struct name_entry {
+	uint32_t xid;
+	int valid;
+	char name[NAME_SIZE];
+};
+
+struct display_names {
+	struct context *ctx;
+	struct xid_table output_names;
+	struct xid_table mode_names;
+	struct xid_table atom_names;
+};
+
+static struct display_names displays[MAX_DISPLAYS];
+static int ndisplays;
+
+int names_init(struct context **ctxs, int num_displays)
+{
+	int err;
+
+	if (num_displays <= 0 || num_displays > MAX_DISPLAYS) {
+		return -EINVAL;
+	}
+
+	for (ndisplays = 0; ndisplays < num_displays; ndisplays++) {
+		struct display_names *d = &displays[ndisplays];
+
+		if ((err = xid_table_init(&d->output_names, sizeof(struct name_entry))) < 0 ||
+		    (err = xid_table_init(&d->mode_names, sizeof(struct name_entry))) < 0 ||
+		    (err = xid_table_init(&d->atom_names, sizeof(struct name_entry))) < 0) {
+			xid_table_free(&d->output_names);
+			xid_table_free(&d->mode_names);
+			names_free();
+			return err;
+		}
+
+		d->ctx = ctxs[ndisplays];
+	}
+
+	return 0;
+}
+
+void names_free(void)
+{
+	while (ndisplays > 0) {
+		ndisplays--;
+		xid_table_free(&displays[ndisplays].output_names);
+		xid_table_free(&displays[ndisplays].mode_names);
+		xid_table_free(&displays[ndisplays].atom_names);
+		displays[ndisplays].ctx = NULL;
+	}
+}
+
+void names_reset(int display, struct context *ctx)
+{
+	struct display_names *d;
+
+	if (display < 0 || display >= ndisplays) {
+		return;
+	}
+
+	d = &displays[display];
+	xid_table_clear(&d->output_names);
+	xid_table_clear(&d->mode_names);
+	xid_table_clear(&d->atom_names);
+	d->ctx = ctx;
+}
+
+/* Name a mode the way xrandr does, e.g. 1920x1080@60.00 */
+static void add_mode(const struct mode_info *mode, void *data)
+{
+	struct display_names *d = data;
+	struct name_entry *entry;
+	double vtotal;
+	double rate;
+
+	if (!(entry = xid_table_get(&d->mode_names, mode->id))) {
+		return;
+	}
+
+	vtotal = mode->vtotal;
+
+	if (mode->flags & RR_DoubleScan) {
+		vtotal *= 2;
+	}
+
+	if (mode->flags & RR_Interlace) {
+		vtotal /= 2;
+	}
+
+	rate = mode->htotal && vtotal ? mode->dot_clock / (mode->htotal * vtotal) : 0;
+
+	snprintf(entry->name, sizeof(entry->name), "%ux%u@%.2f",
+		 mode->width, mode->height, rate);
+	entry->valid = 1;
+}
+
+/*
+ * Modes never change once they have been created, so the mode table only
+ * needs to be fetched when an unknown mode shows up.
+ */
+static void resolve_mode(struct display_names *d, uint32_t mode)
+{
+	struct name_entry *entry;
+
+	if (!mode || xid_table_find(&d->mode_names, mode)) {
+		return;
+	}
+
+	context_modes(d->ctx, add_mode, d);
+
+	/* Don't ask again for a mode that the server doesn't know about */
+	if ((entry = xid_table_get(&d->mode_names, mode)) && !entry->valid) {
+		entry->valid = 1;
+	}
+}
+
+static void resolve_output(struct display_names *d, uint32_t output, int refresh)
+{
+	struct name_entry *entry;
+
+	if (!(entry = xid_table_get(&d->output_names, output))) {
+		return;
+	}
+
+	if (!entry->valid || refresh) {
+		if (context_output_name(d->ctx, output, entry->name,
+					sizeof(entry->name)) < 0) {
+			entry->name[0] = 0;
+		}
+
+		entry->valid = 1;
+	}
+}
+
+/* Atoms are never freed, so their names only need to be looked up once */
+static void resolve_atom(struct display_names *d, uint32_t atom)
+{
+	struct name_entry *entry;
+
+	if (!(entry = xid_table_get(&d->atom_names, atom)) || entry->valid) {
+		return;
+	}
+
+	if (context_atom_name(d->ctx, atom, entry->name, sizeof(entry->name)) < 0) {
+		entry->name[0] = 0;
+	}
+
+	entry->valid = 1;
+}
+
+void names_update(const struct event *event)
+{
+	struct display_names *d;
+
+	if (event->display >= ndisplays) {
+		return;
+	}
+
+	d = &displays[event->display];
+
+	switch (event->type) {
+	case EVENT_OUTPUT_CHANGE:
+		resolve_output(d, event->u.output.output, 1);
+		resolve_mode(d, event->u.output.mode);
+		break;
+
+	case EVENT_CRTC_CHANGE:
+		resolve_mode(d, event->u.crtc.mode);
+		break;
+
+	case EVENT_OUTPUT_PROPERTY:
+		resolve_output(d, event->u.property.xid, 0);
+		resolve_atom(d, event->u.property.atom);
+		break;
+
+	case EVENT_PROVIDER_PROPERTY:
+		resolve_atom(d, event->u.property.atom);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const char *lookup(struct xid_table *table, uint32_t xid)
+{
+	struct name_entry *entry;
+
+	if (!(entry = xid_table_find(table, xid)) || !entry->name[0]) {
+		return "none";
+	}
+
+	return entry->name;
+}
+
+const char *names_output(int display, uint32_t output)
+{
+	if (display < 0 || display >= ndisplays) {
+		return NULL;
+	}
+
+	return lookup(&displays[display].output_names, output);
+}
+
+const char *names_mode(int display, uint32_t mode)
+{
+	if (display < 0 || display >= ndisplays) {
+		return NULL;
+	}
+
+	return lookup(&displays[display].mode_names, mode);
+}
+
+const char *names_atom(int display, uint32_t atom)
+{
+	if (display < 0 || display >= ndisplays) {
+		return NULL;
+	}
+
+	return lookup(&displays[display].atom_names, atom);
+}
@@ -0,0 +1,54 @@
+/*
+ * names.h - Cache of output and mode names
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include "backend.h"
+
+/*
+ * Start resolving names using the connections in ctxs, one for each
+ * display. Until this is called, names_output() and names_mode() return
+ * NULL.
+ */
+int names_init(struct context **ctxs, int num_displays);
+void names_free(void);
+
+/*
+ * Forget all names of a display and resolve them using ctx from now on,
+ * such as after reconnecting to an X server, which assigns new XIDs.
+ */
+void names_reset(int display, struct context *ctx);
+
+/*
+ * Make sure the names of all XIDs in an event are in the cache. Output
+ * change events cause the name of the output to be looked up again.
+ */
+void names_update(const struct event *event);
+
+/*
+ * Cached name of an output, mode, or atom on a display, or NULL if names
+ * aren't resolved
+ */
+const char *names_output(int display, uint32_t output);
+const char *names_mode(int display, uint32_t mode);
+const char *names_atom(int display, uint32_t atom);
+
+#endif /* NAMES_H */
@@ -0,0 +1,1371 @@
+/*
+ * output.c - Formatting and writing of event records
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <X11/X.h>
+#include "backend.h"
+#include "output.h"
+#include "names.h"
+#include "monitor.h"
+#include "provider.h"
+
+#define OUTPUT_BUFFER_SIZE 65536
+
+/*
+ * Room that is kept free while the records of a burst are formatted, for
+ * the longer header of a truncated burst and the end of the burst
+ */
+#define OUTPUT_BURST_RESERVE 64
+
+static const char *event_names[] = {
+	[EVENT_OTHER]             = "other",
+	[EVENT_SCREEN_CHANGE]     = "screen_change",
+	[EVENT_CRTC_CHANGE]       = "crtc_change",
+	[EVENT_OUTPUT_CHANGE]     = "output_change",
+	[EVENT_OUTPUT_PROPERTY]   = "output_property",
+	[EVENT_PROVIDER_CHANGE]   = "provider_change",
+	[EVENT_PROVIDER_PROPERTY] = "provider_property",
+	[EVENT_RESOURCE_CHANGE]   = "resource_change",
+	[EVENT_LEASE]             = "lease"
+};
+
+static const char *rotation_names[] = {
+	[0]             = "E",
+	[RR_Rotate_0]   = "0",
+	[RR_Rotate_90]  = "90",
+	[RR_Rotate_180] = "180",
+	[RR_Rotate_270] = "270"
+};
+
+static const char *reflection_names[] = {
+	[0]                           = "0",
+	[1]                           = "E",
+	[RR_Reflect_X]                = "X",
+	[RR_Reflect_Y]                = "Y",
+	[RR_Reflect_X | RR_Reflect_Y] = "XY"
+};
+
+static const char *connection_names[] = {
+	[RR_Connected]         = "Y",
+	[RR_Disconnected]      = "N",
+	[RR_UnknownConnection] = "?",
+	[3]                    = "E"
+};
+
+static const char *property_state_names[] = {
+	[PropertyNewValue] = "new",
+	[PropertyDelete]   = "deleted",
+	[2]                = "E"
+};
+
+static const char *format_names[] = {
+	[FORMAT_TEXT]   = "text",
+	[FORMAT_JSON]   = "json",
+	[FORMAT_BINARY] = "binary"
+};
+
+static const char *flush_policy_names[] = {
+	[FLUSH_BATCH] = "batch",
+	[FLUSH_LINE]  = "line",
+	[FLUSH_NONE]  = "none"
+};
+
+static const char *backpressure_names[] = {
+	[BACKPRESSURE_BLOCK]    = "block",
+	[BACKPRESSURE_DROP]     = "drop",
+	[BACKPRESSURE_COALESCE] = "coalesce"
+};
+
+struct record_screen_change {
+	struct record_header header;
+	uint32_t timestamp;
+	uint32_t config_timestamp;
+	uint16_t width;
+	uint16_t height;
+	uint16_t mwidth;
+	uint16_t mheight;
+	uint16_t rotation;
+	uint16_t pad;
+};
+
+struct record_crtc_change {
+	struct record_header header;
+	uint32_t crtc;
+	uint32_t mode;
+	int16_t x;
+	int16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint16_t rotation;
+	uint16_t pad;
+};
+
+struct record_output_change {
+	struct record_header header;
+	uint32_t output;
+	uint32_t crtc;
+	uint32_t mode;
+	uint16_t rotation;
+	uint8_t connection;
+	uint8_t pad;
+};
+
+/* Used for both output and provider properties */
+struct record_property {
+	struct record_header header;
+	uint32_t xid;
+	uint32_t atom;
+	uint32_t timestamp;
+	uint8_t state;
+	uint8_t pad[3];
+};
+
+struct record_provider_change {
+	struct record_header header;
+	uint32_t provider;
+	uint32_t timestamp;
+};
+
+struct record_resource_change {
+	struct record_header header;
+	uint32_t timestamp;
+};
+
+struct record_lease {
+	struct record_header header;
+	uint32_t lease;
+	uint32_t timestamp;
+	uint8_t created;
+	uint8_t pad[3];
+};
+
+struct record_burst {
+	struct record_header header;
+	uint32_t events;
+	uint32_t records;
+};
+
+/*
+ * Records waiting to be written can take up OUTPUT_BUFFER_SIZE bytes. One
+ * more record always fits behind them, so that a record that has to be
+ * discarded can still be passed to the hook.
+ */
+static struct {
+	int fd;
+	int flags;
+	enum output_format format;
+	enum flush_policy policy;
+	enum backpressure backpressure;
+	int names;
+	int monitors;
+	int providers;
+	const char *const *sources;
+	int nsources;
+	char data[OUTPUT_BUFFER_SIZE + OUTPUT_RECORD_MAX];
+	size_t len;
+	size_t record;
+	size_t written;
+	int discard;
+	int stalled;
+	unsigned long dropped;
+	unsigned long dropped_total;
+	int wrote;
+	size_t reserve;
+	int truncated;
+} buffer = {
+	.fd = -1,
+	.flags = -1
+};
+
+const char *event_name(int type)
+{
+	return event_names[type > 0 && type < ARRAY_SIZE(event_names) ? type : 0];
+}
+
+const char *rotation_name(const unsigned long rot)
+{
+	unsigned long rotation = rot & 0xf;
+
+	return rotation_names[rotation >= ARRAY_SIZE(rotation_names) ? 0 : rotation];
+}
+
+const char *reflection_name(const unsigned long ref)
+{
+	unsigned long reflection = ref & 0xf0;
+
+	if (reflection & ~(RR_Reflect_X | RR_Reflect_Y)) {
+		reflection = 1;
+	}
+
+	return reflection_names[reflection];
+}
+
+const char *connection_name(const unsigned long conn)
+{
+	return connection_names[conn >= ARRAY_SIZE(connection_names) ? 3 : conn];
+}
+
+const char *property_state_name(const unsigned long state)
+{
+	return property_state_names[state >= ARRAY_SIZE(property_state_names) ? 2 : state];
+}
+
+int output_parse_format(const char *name, enum output_format *format)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(format_names); i++) {
+		if (strcmp(name, format_names[i]) == 0) {
+			*format = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+int output_parse_flush_policy(const char *name, enum flush_policy *policy)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(flush_policy_names); i++) {
+		if (strcmp(name, flush_policy_names[i]) == 0) {
+			*policy = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+int output_parse_backpressure(const char *name, enum backpressure *policy)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(backpressure_names); i++) {
+		if (strcmp(name, backpressure_names[i]) == 0) {
+			*policy = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+void output_init(int fd, enum output_format format, enum flush_policy policy)
+{
+	buffer.fd = fd;
+	buffer.format = format;
+	buffer.policy = policy;
+	buffer.len = 0;
+	buffer.record = 0;
+	buffer.written = 0;
+}
+
+enum output_format output_format(void)
+{
+	return buffer.format;
+}
+
+int output_set_backpressure(enum backpressure policy)
+{
+	buffer.backpressure = policy;
+
+	if (policy == BACKPRESSURE_BLOCK || buffer.fd < 0 || buffer.flags >= 0) {
+		return 0;
+	}
+
+	/* The flags are shared with whoever else has the descriptor open */
+	if ((buffer.flags = fcntl(buffer.fd, F_GETFL)) < 0 ||
+	    fcntl(buffer.fd, F_SETFL, buffer.flags | O_NONBLOCK) < 0) {
+		int err = -errno;
+
+		buffer.flags = -1;
+		buffer.backpressure = BACKPRESSURE_BLOCK;
+		return err;
+	}
+
+	return 0;
+}
+
+void output_free(void)
+{
+	if (buffer.flags >= 0) {
+		fcntl(buffer.fd, F_SETFL, buffer.flags);
+		buffer.flags = -1;
+	}
+
+	if (buffer.dropped_total) {
+		fprintf(stderr, "Dropped %lu records because the output was blocked\n",
+			buffer.dropped_total);
+	}
+}
+
+void output_set_names(int enable)
+{
+	buffer.names = enable;
+}
+
+void output_set_monitors(int enable)
+{
+	buffer.monitors = enable;
+}
+
+void output_set_providers(int enable)
+{
+	buffer.providers = enable;
+}
+
+void output_set_sources(const char *const *displays, int ndisplays)
+{
+	buffer.sources = displays;
+	buffer.nsources = ndisplays;
+}
+
+static const char *output_name(const struct event *event, uint32_t output)
+{
+	return buffer.names ? names_output(event->display, output) : NULL;
+}
+
+static const char *mode_name(const struct event *event, uint32_t mode)
+{
+	return buffer.names ? names_mode(event->display, mode) : NULL;
+}
+
+static const char *atom_name(const struct event *event, uint32_t atom)
+{
+	return buffer.names ? names_atom(event->display, atom) : NULL;
+}
+
+/* Set if monitors are reported, even if the monitor isn't known */
+static int monitor_info(const struct event *event, uint32_t output,
+			const struct monitor_info **info)
+{
+	*info = buffer.monitors ? monitor_lookup(event->display, output) : NULL;
+
+	return buffer.monitors;
+}
+
+/* Set if providers are reported, even if the provider isn't known */
+static int provider_info(const struct event *event, uint32_t provider,
+			 const struct provider_info **info)
+{
+	*info = buffer.providers ? provider_lookup(event->display, provider) : NULL;
+
+	return buffer.providers;
+}
+
+/*
+ * Write the records in the buffer that haven't been written yet. If the
+ * descriptor is non-blocking, this stops as soon as it would block, and
+ * the rest is written once the descriptor becomes writable.
+ */
+static int buffer_write(void)
+{
+	size_t end = buffer.discard ? buffer.record : buffer.len;
+	size_t start = buffer.written;
+
+	while (buffer.written < end) {
+		ssize_t written = write(buffer.fd, buffer.data + buffer.written,
+					end - buffer.written);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				buffer.stalled = 1;
+				return 0;
+			}
+
+			return -errno;
+		}
+
+		buffer.written += written;
+	}
+
+	buffer.stalled = 0;
+
+	if (buffer.written > start) {
+		buffer.wrote = 1;
+	}
+
+	return 0;
+}
+
+int output_flush(void)
+{
+	int err = 0;
+
+	if (buffer.fd >= 0 && (err = buffer_write()) == 0 && buffer.stalled) {
+		return 0;
+	}
+
+	buffer.len = 0;
+	buffer.record = 0;
+	buffer.written = 0;
+	buffer.discard = 0;
+	buffer.stalled = 0;
+
+	return err;
+}
+
+int output_blocked(void)
+{
+	return buffer.stalled &&
+	       buffer.len - buffer.written > OUTPUT_BUFFER_SIZE - OUTPUT_RECORD_MAX;
+}
+
+int output_pollfd(struct pollfd *fd)
+{
+	if (!buffer.stalled) {
+		return 0;
+	}
+
+	fd->fd = buffer.fd;
+	fd->events = POLLOUT;
+
+	return 1;
+}
+
+int output_written(void)
+{
+	int wrote = buffer.wrote;
+
+	buffer.wrote = 0;
+
+	return wrote;
+}
+
+unsigned long output_dropped(void)
+{
+	unsigned long dropped = buffer.dropped;
+
+	buffer.dropped = 0;
+
+	return dropped;
+}
+
+int output_end_batch(void)
+{
+	return buffer.policy == FLUSH_NONE ? 0 : output_flush();
+}
+
+/*
+ * With the line policy, each record is written as soon as it is complete.
+ * It stays in the buffer until the next record is started, so that it can
+ * still be passed to the hook.
+ */
+static void record_end(void)
+{
+	if (buffer.policy == FLUSH_LINE && buffer.fd >= 0) {
+		buffer_write();
+	}
+}
+
+/*
+ * Make sure that the next record fits into the buffer. If the records
+ * before it can't be written without blocking, the next record is
+ * formatted, but discarded when the record after it is started.
+ */
+static void record_begin(void)
+{
+	if (buffer.discard) {
+		buffer.len = buffer.record;
+		buffer.discard = 0;
+	}
+
+	if (buffer.written == buffer.len) {
+		buffer.len = buffer.written = 0;
+	}
+
+	if (OUTPUT_BUFFER_SIZE - buffer.len < OUTPUT_RECORD_MAX) {
+		output_flush();
+	}
+
+	if (OUTPUT_BUFFER_SIZE - buffer.len < OUTPUT_RECORD_MAX) {
+		memmove(buffer.data, buffer.data + buffer.written,
+			buffer.len - buffer.written);
+		buffer.len -= buffer.written;
+		buffer.written = 0;
+	}
+
+	if (OUTPUT_BUFFER_SIZE - buffer.len < OUTPUT_RECORD_MAX) {
+		buffer.discard = 1;
+		buffer.dropped++;
+		buffer.dropped_total++;
+	}
+
+	buffer.record = buffer.len;
+}
+
+/*
+ * Room left in the current record, minus what is reserved for the end of
+ * a burst. 0 if nothing fits any more.
+ */
+static size_t record_room(void)
+{
+	size_t end = buffer.record + OUTPUT_RECORD_MAX - buffer.reserve;
+
+	return buffer.len < end ? end - buffer.len : 0;
+}
+
+/*
+ * Append formatted text to the current record, truncating it if necessary.
+ * Truncation is remembered in buffer.truncated.
+ */
+static void record_printf(const char *fmt, ...)
+{
+	size_t limit;
+	va_list args;
+	int len;
+
+	if (!(limit = record_room())) {
+		buffer.truncated = 1;
+		return;
+	}
+
+	va_start(args, fmt);
+	len = vsnprintf(buffer.data + buffer.len, limit, fmt, args);
+	va_end(args);
+
+	if (len > 0) {
+		if ((size_t)len >= limit) {
+			buffer.truncated = 1;
+			len = limit - 1;
+		}
+
+		buffer.len += len;
+	}
+}
+
+/*
+ * Append str as a JSON string. Names come from the X server and from the
+ * command line, so quotes, backslashes, and control characters have to
+ * be escaped.
+ */
+static void json_string(const char *str)
+{
+	size_t len;
+
+	record_printf("\"");
+
+	while (*str) {
+		for (len = 0; str[len] && str[len] != '"' && str[len] != '\\' &&
+			      (unsigned char)str[len] >= 0x20; len++);
+
+		if (len) {
+			record_printf("%.*s", (int)len, str);
+			str += len;
+		} else if (*str == '"' || *str == '\\') {
+			record_printf("\\%c", *str++);
+		} else {
+			record_printf("\\u%04x", (unsigned char)*str++);
+		}
+	}
+
+	record_printf("\"");
+}
+
+/* Append a member with a string value, as in ,"name":"value" */
+static void json_member(const char *name, const char *value)
+{
+	record_printf(",\"%s\":", name);
+	json_string(value);
+}
+
+static void record_write(const void *data, size_t len)
+{
+	if (len > record_room()) {
+		buffer.truncated = 1;
+		return;
+	}
+
+	memcpy(buffer.data + buffer.len, data, len);
+	buffer.len += len;
+}
+
+static void text_screen_change_event(const struct event *event)
+{
+	record_printf("XRRScreenChangeNotifyEvent res=%dx%d mm=%dx%d rotation=%s reflection=%s timestamp=%lu config_timestamp=%lu",
+		      event->u.screen.width, event->u.screen.height,
+		      event->u.screen.mwidth, event->u.screen.mheight,
+		      rotation_name(event->u.screen.rotation),
+		      reflection_name(event->u.screen.rotation),
+		      (unsigned long)event->u.screen.timestamp,
+		      (unsigned long)event->u.screen.config_timestamp);
+}
+
+static void text_output_change_event(const struct event *event)
+{
+	const struct monitor_info *info;
+	const char *name;
+
+	record_printf("XRROutputChangeNotifyEvent output=0x%lx crtc=0x%lx mode=0x%lx connection=%s",
+		      (unsigned long)event->u.output.output,
+		      (unsigned long)event->u.output.crtc,
+		      (unsigned long)event->u.output.mode,
+		      connection_name(event->u.output.connection));
+
+	if ((name = output_name(event, event->u.output.output))) {
+		record_printf(" name=%s mode_name=%s", name,
+			      mode_name(event, event->u.output.mode));
+	}
+
+	if (monitor_info(event, event->u.output.output, &info)) {
+		record_printf(" monitor_id=%s vendor=%s model=%s serial=%s",
+			      info ? info->id : "none", info ? info->vendor : "none",
+			      info ? info->model : "none", info ? info->serial : "none");
+	}
+}
+
+static void text_crtc_change_event(const struct event *event)
+{
+	const char *name;
+
+	record_printf("XRRCrtcChangeNotifyEvent crtc=0x%lx res=%dx%d pos=%dx%d mode=0x%lx rotation=%s reflection=%s",
+		      (unsigned long)event->u.crtc.crtc,
+		      event->u.crtc.width, event->u.crtc.height,
+		      event->u.crtc.x, event->u.crtc.y,
+		      (unsigned long)event->u.crtc.mode,
+		      rotation_name(event->u.crtc.rotation),
+		      reflection_name(event->u.crtc.rotation));
+
+	if ((name = mode_name(event, event->u.crtc.mode))) {
+		record_printf(" mode_name=%s", name);
+	}
+}
+
+static void text_output_property_event(const struct event *event)
+{
+	const char *name;
+
+	record_printf("XRROutputPropertyNotifyEvent output=0x%lx property=0x%lx state=%s timestamp=%lu",
+		      (unsigned long)event->u.property.xid,
+		      (unsigned long)event->u.property.atom,
+		      property_state_name(event->u.property.state),
+		      (unsigned long)event->u.property.timestamp);
+
+	if ((name = output_name(event, event->u.property.xid))) {
+		record_printf(" name=%s property_name=%s", name,
+			      atom_name(event, event->u.property.atom));
+	}
+}
+
+static void text_provider_change_event(const struct event *event)
+{
+	const struct provider_info *info;
+	char caps[PROVIDER_CAPABILITIES_SIZE];
+
+	record_printf("XRRProviderChangeNotifyEvent provider=0x%lx timestamp=%lu",
+		      (unsigned long)event->u.provider.provider,
+		      (unsigned long)event->u.provider.timestamp);
+
+	if (provider_info(event, event->u.provider.provider, &info)) {
+		record_printf(" name=%s capabilities=%s crtcs=%u outputs=%u",
+			      info && info->name[0] ? info->name : "none",
+			      info ? provider_capabilities(info->capabilities, caps, sizeof(caps)) : "none",
+			      info ? info->ncrtcs : 0, info ? info->noutputs : 0);
+	}
+}
+
+static void text_provider_property_event(const struct event *event)
+{
+	const char *name;
+
+	record_printf("XRRProviderPropertyNotifyEvent provider=0x%lx property=0x%lx state=%s timestamp=%lu",
+		      (unsigned long)event->u.property.xid,
+		      (unsigned long)event->u.property.atom,
+		      property_state_name(event->u.property.state),
+		      (unsigned long)event->u.property.timestamp);
+
+	if ((name = atom_name(event, event->u.property.atom))) {
+		record_printf(" property_name=%s", name);
+	}
+}
+
+static void text_resource_change_event(const struct event *event)
+{
+	const struct provider_info *info;
+	int i;
+
+	record_printf("XRRResourceChangeNotifyEvent timestamp=%lu",
+		      (unsigned long)event->u.resource.timestamp);
+
+	if (buffer.providers) {
+		record_printf(" providers=");
+
+		for (i = 0; (info = provider_get(event->display, i)); i++) {
+			record_printf("%s0x%lx", i ? "," : "", (unsigned long)info->provider);
+		}
+
+		if (!i) {
+			record_printf("none");
+		}
+	}
+}
+
+static void text_lease_event(const struct event *event)
+{
+	record_printf("XRRLeaseNotifyEvent lease=0x%lx created=%s timestamp=%lu",
+		      (unsigned long)event->u.lease.lease,
+		      event->u.lease.created ? "Y" : "N",
+		      (unsigned long)event->u.lease.timestamp);
+}
+
+static void json_screen_change_event(const struct event *event)
+{
+	record_printf("{\"event\":\"screen_change\",\"width\":%d,\"height\":%d,"
+		      "\"mwidth\":%d,\"mheight\":%d",
+		      event->u.screen.width, event->u.screen.height,
+		      event->u.screen.mwidth, event->u.screen.mheight);
+	json_member("rotation", rotation_name(event->u.screen.rotation));
+	json_member("reflection", reflection_name(event->u.screen.rotation));
+	record_printf(",\"timestamp\":%lu,\"config_timestamp\":%lu",
+		      (unsigned long)event->u.screen.timestamp,
+		      (unsigned long)event->u.screen.config_timestamp);
+}
+
+static void json_output_change_event(const struct event *event)
+{
+	const struct monitor_info *info;
+	const char *name;
+
+	record_printf("{\"event\":\"output_change\",\"output\":%lu,\"crtc\":%lu,"
+		      "\"mode\":%lu",
+		      (unsigned long)event->u.output.output,
+		      (unsigned long)event->u.output.crtc,
+		      (unsigned long)event->u.output.mode);
+	json_member("connection", connection_name(event->u.output.connection));
+
+	if ((name = output_name(event, event->u.output.output))) {
+		json_member("name", name);
+		json_member("mode_name", mode_name(event, event->u.output.mode));
+	}
+
+	if (monitor_info(event, event->u.output.output, &info)) {
+		if (info) {
+			json_member("monitor_id", info->id);
+			json_member("vendor", info->vendor);
+			json_member("model", info->model);
+			json_member("serial", info->serial);
+		} else {
+			record_printf(",\"monitor_id\":null");
+		}
+	}
+}
+
+static void json_crtc_change_event(const struct event *event)
+{
+	const char *name;
+
+	record_printf("{\"event\":\"crtc_change\",\"crtc\":%lu,\"mode\":%lu,"
+		      "\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d",
+		      (unsigned long)event->u.crtc.crtc,
+		      (unsigned long)event->u.crtc.mode,
+		      event->u.crtc.x, event->u.crtc.y,
+		      event->u.crtc.width, event->u.crtc.height);
+	json_member("rotation", rotation_name(event->u.crtc.rotation));
+	json_member("reflection", reflection_name(event->u.crtc.rotation));
+
+	if ((name = mode_name(event, event->u.crtc.mode))) {
+		json_member("mode_name", name);
+	}
+}
+
+static void json_property_event(const struct event *event)
+{
+	const char *name;
+
+	record_printf("{\"event\":");
+	json_string(event_name(event->type));
+	record_printf(",\"%s\":%lu,\"property\":%lu",
+		      event->type == EVENT_OUTPUT_PROPERTY ? "output" : "provider",
+		      (unsigned long)event->u.property.xid,
+		      (unsigned long)event->u.property.atom);
+	json_member("state", property_state_name(event->u.property.state));
+	record_printf(",\"timestamp\":%lu", (unsigned long)event->u.property.timestamp);
+
+	if (event->type == EVENT_OUTPUT_PROPERTY &&
+	    (name = output_name(event, event->u.property.xid))) {
+		json_member("name", name);
+	}
+
+	if ((name = atom_name(event, event->u.property.atom))) {
+		json_member("property_name", name);
+	}
+}
+
+static void json_provider_change_event(const struct event *event)
+{
+	const struct provider_info *info;
+	char caps[PROVIDER_CAPABILITIES_SIZE];
+
+	record_printf("{\"event\":\"provider_change\",\"provider\":%lu,\"timestamp\":%lu",
+		      (unsigned long)event->u.provider.provider,
+		      (unsigned long)event->u.provider.timestamp);
+
+	if (provider_info(event, event->u.provider.provider, &info)) {
+		if (info) {
+			json_member("name", info->name);
+			json_member("capabilities",
+				    provider_capabilities(info->capabilities, caps, sizeof(caps)));
+			record_printf(",\"crtcs\":%u,\"outputs\":%u",
+				      info->ncrtcs, info->noutputs);
+		} else {
+			record_printf(",\"name\":null");
+		}
+	}
+}
+
+static void json_resource_change_event(const struct event *event)
+{
+	const struct provider_info *info;
+	int i;
+
+	record_printf("{\"event\":\"resource_change\",\"timestamp\":%lu",
+		      (unsigned long)event->u.resource.timestamp);
+
+	if (buffer.providers) {
+		record_printf(",\"providers\":[");
+
+		for (i = 0; (info = provider_get(event->display, i)); i++) {
+			record_printf("%s%lu", i ? "," : "", (unsigned long)info->provider);
+		}
+
+		record_printf("]");
+	}
+}
+
+static void json_lease_event(const struct event *event)
+{
+	record_printf("{\"event\":\"lease\",\"lease\":%lu,\"created\":%s,\"timestamp\":%lu",
+		      (unsigned long)event->u.lease.lease,
+		      event->u.lease.created ? "true" : "false",
+		      (unsigned long)event->u.lease.timestamp);
+}
+
+union record {
+	struct record_header header;
+	struct record_screen_change screen;
+	struct record_crtc_change crtc;
+	struct record_output_change output;
+	struct record_property property;
+	struct record_provider_change provider;
+	struct record_resource_change resource;
+	struct record_lease lease;
+};
+
+static uint8_t event_source(const struct event *event)
+{
+	return (event->display & 0xf) << 4 | (event->screen & 0xf);
+}
+
+size_t output_encode(const struct event *event, void *data, size_t size)
+{
+	union record rec;
+
+	memset(&rec, 0, sizeof(rec));
+
+	switch (event->type) {
+	case EVENT_SCREEN_CHANGE:
+		rec.header.length = sizeof(rec.screen);
+		rec.screen.timestamp = event->u.screen.timestamp;
+		rec.screen.config_timestamp = event->u.screen.config_timestamp;
+		rec.screen.width = event->u.screen.width;
+		rec.screen.height = event->u.screen.height;
+		rec.screen.mwidth = event->u.screen.mwidth;
+		rec.screen.mheight = event->u.screen.mheight;
+		rec.screen.rotation = event->u.screen.rotation;
+		break;
+
+	case EVENT_CRTC_CHANGE:
+		rec.header.length = sizeof(rec.crtc);
+		rec.crtc.crtc = event->u.crtc.crtc;
+		rec.crtc.mode = event->u.crtc.mode;
+		rec.crtc.x = event->u.crtc.x;
+		rec.crtc.y = event->u.crtc.y;
+		rec.crtc.width = event->u.crtc.width;
+		rec.crtc.height = event->u.crtc.height;
+		rec.crtc.rotation = event->u.crtc.rotation;
+		break;
+
+	case EVENT_OUTPUT_CHANGE:
+		rec.header.length = sizeof(rec.output);
+		rec.output.output = event->u.output.output;
+		rec.output.crtc = event->u.output.crtc;
+		rec.output.mode = event->u.output.mode;
+		rec.output.rotation = event->u.output.rotation;
+		rec.output.connection = event->u.output.connection;
+		break;
+
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		rec.header.length = sizeof(rec.property);
+		rec.property.xid = event->u.property.xid;
+		rec.property.atom = event->u.property.atom;
+		rec.property.timestamp = event->u.property.timestamp;
+		rec.property.state = event->u.property.state;
+		break;
+
+	case EVENT_PROVIDER_CHANGE:
+		rec.header.length = sizeof(rec.provider);
+		rec.provider.provider = event->u.provider.provider;
+		rec.provider.timestamp = event->u.provider.timestamp;
+		break;
+
+	case EVENT_RESOURCE_CHANGE:
+		rec.header.length = sizeof(rec.resource);
+		rec.resource.timestamp = event->u.resource.timestamp;
+		break;
+
+	case EVENT_LEASE:
+		rec.header.length = sizeof(rec.lease);
+		rec.lease.lease = event->u.lease.lease;
+		rec.lease.timestamp = event->u.lease.timestamp;
+		rec.lease.created = event->u.lease.created;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (rec.header.length > size) {
+		return 0;
+	}
+
+	/* Record types are the same as event types */
+	rec.header.type = event->type;
+	rec.header.source = event_source(event);
+	memcpy(data, &rec, rec.header.length);
+
+	return rec.header.length;
+}
+
+int output_decode(const void *data, size_t len, struct event *event)
+{
+	union record rec;
+	size_t reclen;
+
+	if (len < sizeof(rec.header)) {
+		return 0;
+	}
+
+	memcpy(&rec.header, data, sizeof(rec.header));
+
+	if (rec.header.length < sizeof(rec.header)) {
+		return -EINVAL;
+	}
+
+	if (rec.header.length > len) {
+		return 0;
+	}
+
+	reclen = rec.header.length;
+	memset(&rec, 0, sizeof(rec));
+	memcpy(&rec, data, reclen < sizeof(rec) ? reclen : sizeof(rec));
+
+	memset(event, 0, sizeof(*event));
+	event->type = EVENT_OTHER;
+	event->display = rec.header.source >> 4;
+	event->screen = rec.header.source & 0xf;
+
+	switch (rec.header.type) {
+	case RECORD_SCREEN_CHANGE:
+		if (reclen < sizeof(rec.screen)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_SCREEN_CHANGE;
+		event->u.screen.timestamp = rec.screen.timestamp;
+		event->u.screen.config_timestamp = rec.screen.config_timestamp;
+		event->u.screen.width = rec.screen.width;
+		event->u.screen.height = rec.screen.height;
+		event->u.screen.mwidth = rec.screen.mwidth;
+		event->u.screen.mheight = rec.screen.mheight;
+		event->u.screen.rotation = rec.screen.rotation;
+		break;
+
+	case RECORD_CRTC_CHANGE:
+		if (reclen < sizeof(rec.crtc)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_CRTC_CHANGE;
+		event->u.crtc.crtc = rec.crtc.crtc;
+		event->u.crtc.mode = rec.crtc.mode;
+		event->u.crtc.x = rec.crtc.x;
+		event->u.crtc.y = rec.crtc.y;
+		event->u.crtc.width = rec.crtc.width;
+		event->u.crtc.height = rec.crtc.height;
+		event->u.crtc.rotation = rec.crtc.rotation;
+		break;
+
+	case RECORD_OUTPUT_CHANGE:
+		if (reclen < sizeof(rec.output)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_OUTPUT_CHANGE;
+		event->u.output.output = rec.output.output;
+		event->u.output.crtc = rec.output.crtc;
+		event->u.output.mode = rec.output.mode;
+		event->u.output.rotation = rec.output.rotation;
+		event->u.output.connection = rec.output.connection;
+		break;
+
+	case RECORD_OUTPUT_PROPERTY:
+	case RECORD_PROVIDER_PROPERTY:
+		if (reclen < sizeof(rec.property)) {
+			return -EINVAL;
+		}
+
+		event->type = rec.header.type;
+		event->u.property.xid = rec.property.xid;
+		event->u.property.atom = rec.property.atom;
+		event->u.property.timestamp = rec.property.timestamp;
+		event->u.property.state = rec.property.state;
+		break;
+
+	case RECORD_PROVIDER_CHANGE:
+		if (reclen < sizeof(rec.provider)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_PROVIDER_CHANGE;
+		event->u.provider.provider = rec.provider.provider;
+		event->u.provider.timestamp = rec.provider.timestamp;
+		break;
+
+	case RECORD_RESOURCE_CHANGE:
+		if (reclen < sizeof(rec.resource)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_RESOURCE_CHANGE;
+		event->u.resource.timestamp = rec.resource.timestamp;
+		break;
+
+	case RECORD_LEASE:
+		if (reclen < sizeof(rec.lease)) {
+			return -EINVAL;
+		}
+
+		event->type = EVENT_LEASE;
+		event->u.lease.lease = rec.lease.lease;
+		event->u.lease.timestamp = rec.lease.timestamp;
+		event->u.lease.created = rec.lease.created;
+		break;
+
+	default:
+		/* Unknown records are skipped */
+		break;
+	}
+
+	return reclen;
+}
+
+static void binary_event(const struct event *event)
+{
+	buffer.len += output_encode(event, buffer.data + buffer.len,
+				    sizeof(buffer.data) - buffer.len);
+}
+
+static const struct {
+	void (*format[3])(const struct event *event);
+} formatters[] = {
+	[EVENT_SCREEN_CHANGE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_screen_change_event,
+			[FORMAT_JSON]   = json_screen_change_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_CRTC_CHANGE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_crtc_change_event,
+			[FORMAT_JSON]   = json_crtc_change_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_OUTPUT_CHANGE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_output_change_event,
+			[FORMAT_JSON]   = json_output_change_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_OUTPUT_PROPERTY] = {
+		.format = {
+			[FORMAT_TEXT]   = text_output_property_event,
+			[FORMAT_JSON]   = json_property_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_PROVIDER_CHANGE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_provider_change_event,
+			[FORMAT_JSON]   = json_provider_change_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_PROVIDER_PROPERTY] = {
+		.format = {
+			[FORMAT_TEXT]   = text_provider_property_event,
+			[FORMAT_JSON]   = json_property_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_RESOURCE_CHANGE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_resource_change_event,
+			[FORMAT_JSON]   = json_resource_change_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	},
+	[EVENT_LEASE] = {
+		.format = {
+			[FORMAT_TEXT]   = text_lease_event,
+			[FORMAT_JSON]   = json_lease_event,
+			[FORMAT_BINARY] = binary_event
+		}
+	}
+};
+
+static const char *source_name(const struct event *event)
+{
+	if (event->display >= buffer.nsources || !buffer.sources[event->display]) {
+		return "";
+	}
+
+	return buffer.sources[event->display];
+}
+
+static int format_event(const char *separator, const struct event *event)
+{
+	void (*format)(const struct event*);
+	size_t start;
+
+	if (event->type >= ARRAY_SIZE(formatters) ||
+	    !(format = formatters[event->type].format[buffer.format])) {
+		return 0;
+	}
+
+	if (buffer.format != FORMAT_BINARY) {
+		record_printf("%s", separator);
+	}
+
+	start = buffer.len;
+	format(event);
+
+	switch (buffer.format) {
+	case FORMAT_TEXT:
+		if (buffer.sources) {
+			record_printf(" display=%s screen=%d",
+				      source_name(event), event->screen);
+		}
+		break;
+
+	case FORMAT_JSON:
+		if (buffer.sources) {
+			json_member("display", source_name(event));
+			record_printf(",\"screen\":%d", event->screen);
+		}
+		record_printf("}");
+		break;
+
+	case FORMAT_BINARY:
+		if (!buffer.sources && buffer.len > start) {
+			buffer.data[start + offsetof(struct record_header, source)] = 0;
+		}
+		break;
+	}
+
+	return 1;
+}
+
+int output_event(const struct event *event)
+{
+	record_begin();
+
+	if (!format_event("", event)) {
+		return 0;
+	}
+
+	if (buffer.format != FORMAT_BINARY) {
+		record_printf("\n");
+	}
+
+	record_end();
+
+	return 1;
+}
+
+/*
+ * Replace the header of a truncated text burst, which is header bytes
+ * long, with one that has the number of records that were left out. The
+ * new header is longer, which OUTPUT_BURST_RESERVE makes room for.
+ */
+static void burst_text_header(size_t header, int received, int written, int omitted)
+{
+	char *record = buffer.data + buffer.record;
+	char str[OUTPUT_BURST_RESERVE];
+	int len;
+
+	len = snprintf(str, sizeof(str), "XRRBurst events=%d records=%d truncated=%d",
+		       received, written, omitted);
+
+	memmove(record + len, record + header, buffer.len - buffer.record - header);
+	memcpy(record, str, len);
+	buffer.len += len - header;
+}
+
+/*
+ * Bursts are formatted as
+ *
+ *   text:   XRRBurst events=N records=M<TAB>record<TAB>record...
+ *   json:   {"event":"burst","events":N,"records":[record,record...]}
+ *   binary: struct record_burst, followed by M records
+ *
+ * where N is the number of events received and M the number of records
+ * that remain after coalescing. If the records don't all fit into
+ * OUTPUT_RECORD_MAX, the burst ends with the last one that does, and the
+ * text and JSON formats say how many were left out:
+ *
+ *   text:   XRRBurst events=N records=M truncated=T<TAB>record...
+ *   json:   {"event":"burst",...,"records":[record...],"truncated":T}
+ */
+void output_burst(int received, const struct event *events, int nevents)
+{
+	struct record_burst rec;
+	const char *separator;
+	size_t header;
+	int nrecords;
+	int omitted;
+	int written;
+	int i;
+
+	for (nrecords = i = 0; i < nevents; i++) {
+		if (events[i].type < ARRAY_SIZE(formatters) &&
+		    formatters[events[i].type].format[buffer.format]) {
+			nrecords++;
+		}
+	}
+
+	record_begin();
+
+	switch (buffer.format) {
+	case FORMAT_TEXT:
+		record_printf("XRRBurst events=%d records=%d", received, nrecords);
+		separator = "\t";
+		break;
+
+	case FORMAT_JSON:
+		record_printf("{\"event\":\"burst\",\"events\":%d,\"records\":[",
+			      received);
+		separator = "";
+		break;
+
+	case FORMAT_BINARY:
+		memset(&rec, 0, sizeof(rec));
+		rec.header.length = sizeof(rec);
+		rec.header.type = RECORD_BURST;
+		rec.events = received;
+		rec.records = nrecords;
+		record_write(&rec, sizeof(rec));
+		separator = "";
+		break;
+
+	default:
+		return;
+	}
+
+	/* Records that don't fit entirely are taken back out */
+	header = buffer.len - buffer.record;
+	buffer.reserve = OUTPUT_BURST_RESERVE;
+	buffer.truncated = 0;
+
+	for (written = i = 0; i < nevents; i++) {
+		size_t end = buffer.len;
+
+		if (!format_event(separator, &events[i])) {
+			continue;
+		}
+
+		if (buffer.truncated) {
+			buffer.len = end;
+			break;
+		}
+
+		written++;
+
+		if (buffer.format == FORMAT_JSON) {
+			separator = ",";
+		}
+	}
+
+	buffer.reserve = 0;
+	buffer.truncated = 0;
+	omitted = nrecords - written;
+
+	switch (buffer.format) {
+	case FORMAT_TEXT:
+		if (omitted) {
+			burst_text_header(header, received, written, omitted);
+		}
+
+		record_printf("\n");
+		break;
+
+	case FORMAT_JSON:
+		if (omitted) {
+			record_printf("],\"truncated\":%d}\n", omitted);
+		} else {
+			record_printf("]}\n");
+		}
+		break;
+
+	case FORMAT_BINARY:
+		if (omitted) {
+			rec.records = written;
+			memcpy(buffer.data + buffer.record, &rec, sizeof(rec));
+		}
+		break;
+	}
+
+	record_end();
+}
+
+const char *output_record(size_t *len)
+{
+	*len = buffer.len - buffer.record;
+
+	return buffer.data + buffer.record;
+}
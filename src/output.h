@@ -0,0 +1,183 @@
+/*
+ * output.h - Formatting and writing of event records
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <poll.h>
+#include "backend.h"
+
+/* Maximum length of a single record, including bursts */
+#define OUTPUT_RECORD_MAX 16384
+
+enum output_format {
+	FORMAT_TEXT = 0,
+	FORMAT_JSON,
+	FORMAT_BINARY
+};
+
+enum flush_policy {
+	FLUSH_BATCH = 0,
+	FLUSH_LINE,
+	FLUSH_NONE
+};
+
+/* What to do with records if the output can't keep up with them */
+enum backpressure {
+	BACKPRESSURE_BLOCK = 0,
+	BACKPRESSURE_DROP,
+	BACKPRESSURE_COALESCE
+};
+
+/* Type field of binary records */
+enum record_type {
+	RECORD_SCREEN_CHANGE     = EVENT_SCREEN_CHANGE,
+	RECORD_CRTC_CHANGE       = EVENT_CRTC_CHANGE,
+	RECORD_OUTPUT_CHANGE     = EVENT_OUTPUT_CHANGE,
+	RECORD_OUTPUT_PROPERTY   = EVENT_OUTPUT_PROPERTY,
+	RECORD_PROVIDER_CHANGE   = EVENT_PROVIDER_CHANGE,
+	RECORD_PROVIDER_PROPERTY = EVENT_PROVIDER_PROPERTY,
+	RECORD_RESOURCE_CHANGE   = EVENT_RESOURCE_CHANGE,
+	RECORD_LEASE             = EVENT_LEASE,
+	RECORD_BURST             = 0x80,
+	RECORD_HELLO             = 0x81
+};
+
+/*
+ * Binary records start with this header, followed by the fields of the
+ * event. All fields are in host byte order. If more than one screen is
+ * watched, source holds the display index in the upper and the screen in
+ * the lower four bits.
+ */
+struct record_header {
+	uint16_t length;
+	uint8_t type;
+	uint8_t source;
+};
+
+const char *event_name(int type);
+const char *rotation_name(const unsigned long rot);
+const char *reflection_name(const unsigned long ref);
+const char *connection_name(const unsigned long conn);
+const char *property_state_name(const unsigned long state);
+
+int output_parse_format(const char *name, enum output_format *format);
+int output_parse_flush_policy(const char *name, enum flush_policy *policy);
+int output_parse_backpressure(const char *name, enum backpressure *policy);
+
+/*
+ * Records are collected in a buffer and written to fd when the buffer is
+ * flushed. If fd is negative, records are formatted but not written.
+ */
+void output_init(int fd, enum output_format format, enum flush_policy policy);
+enum output_format output_format(void);
+
+/*
+ * Unless policy is BACKPRESSURE_BLOCK, make the descriptor non-blocking.
+ * Records that can't be written right away are then kept in the buffer,
+ * and records that don't fit into it any more are dropped. Coalescing is
+ * up to the caller. Returns 0 on success, or a negative error number.
+ */
+int output_set_backpressure(enum backpressure policy);
+
+/* Restore the flags of the descriptor and report dropped records */
+void output_free(void);
+
+/* Include the names of outputs and modes in text and JSON records */
+void output_set_names(int enable);
+
+/* Include the monitors connected to outputs in text and JSON records */
+void output_set_monitors(int enable);
+
+/* Include the names and capabilities of providers in text and JSON records */
+void output_set_providers(int enable);
+
+/*
+ * Tag records with the display and screen that they originate from.
+ * displays[i] is the name of the display with index i. The array must
+ * remain valid for as long as records are written.
+ */
+void output_set_sources(const char *const *displays, int ndisplays);
+
+/*
+ * Append the record for an event to the buffer. Returns 1 if a record was
+ * appended, or 0 if events of this type are not reported.
+ */
+int output_event(const struct event *event);
+
+/*
+ * Append a record for a burst of events, i.e. a header followed by one
+ * entry for each of the nevents coalesced events.
+ */
+void output_burst(int received, const struct event *events, int nevents);
+
+/*
+ * Encode an event as a binary record, with the source field always set.
+ * Returns the length of the record, or 0 if the event has no binary
+ * representation or doesn't fit into size bytes.
+ */
+size_t output_encode(const struct event *event, void *data, size_t size);
+
+/*
+ * Decode the binary record at the start of the len bytes at data. Returns
+ * the length of the record, 0 if the record is incomplete, or a negative
+ * error number if the data is not a valid record. Records of unknown types
+ * are decoded as EVENT_OTHER, so that they can be skipped.
+ */
+int output_decode(const void *data, size_t len, struct event *event);
+
+/*
+ * Return the most recently appended record. For text formats, the trailing
+ * newline is included in len.
+ */
+const char *output_record(size_t *len);
+
+/*
+ * Signal that all pending events have been handled. Depending on the flush
+ * policy, this flushes the buffer.
+ */
+int output_end_batch(void);
+
+/*
+ * Write all buffered records with a single write(). With a non-blocking
+ * descriptor, whatever can't be written stays in the buffer.
+ */
+int output_flush(void);
+
+/* Return 1 if the next record would be dropped because the buffer is full */
+int output_blocked(void);
+
+/*
+ * Store the descriptor in fd if written records are waiting for it to
+ * become writable. Returns the number of descriptors stored, 0 or 1.
+ */
+int output_pollfd(struct pollfd *fd);
+
+/*
+ * Return 1 if all records that were not dropped have been written to the
+ * descriptor since the last call, and anything was written at all
+ */
+int output_written(void);
+
+/* Number of records that were dropped since the last call */
+unsigned long output_dropped(void);
+
+#endif /* OUTPUT_H */
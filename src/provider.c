@@ -0,0 +1,217 @@
+/*
+ * provider.c - Cached table of the providers of each display
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "backend.h"
+#include "provider.h"
+
+struct display_providers {
+	struct context *ctx;
+	int valid;
+	int nproviders;
+	struct provider_info providers[PROVIDER_MAX];
+};
+
+static const struct {
+	uint32_t mask;
+	const char *name;
+} capability_names[] = {
+	{ RR_Capability_SourceOutput,  "source_output" },
+	{ RR_Capability_SinkOutput,    "sink_output" },
+	{ RR_Capability_SourceOffload, "source_offload" },
+	{ RR_Capability_SinkOffload,   "sink_offload" }
+};
+
+static struct display_providers displays[MAX_DISPLAYS];
+static int ndisplays;
+
+/* Set while the snapshot is passed on, whose events don't change anything */
+static int in_snapshot;
+
+int provider_init(struct context **ctxs, int num_displays)
+{
+	if (num_displays <= 0 || num_displays > MAX_DISPLAYS) {
+		return -EINVAL;
+	}
+
+	for (ndisplays = 0; ndisplays < num_displays; ndisplays++) {
+		provider_reset(ndisplays, ctxs[ndisplays]);
+	}
+
+	return 0;
+}
+
+void provider_free(void)
+{
+	while (ndisplays > 0) {
+		ndisplays--;
+		displays[ndisplays].ctx = NULL;
+		displays[ndisplays].valid = 0;
+	}
+}
+
+void provider_reset(int display, struct context *ctx)
+{
+	if (display < 0 || display >= MAX_DISPLAYS) {
+		return;
+	}
+
+	displays[display].ctx = ctx;
+	displays[display].valid = 0;
+	displays[display].nproviders = 0;
+}
+
+static void add_provider(const struct provider_info *provider, void *data)
+{
+	struct display_providers *d = data;
+	struct provider_info *p;
+	size_t i;
+
+	if (d->nproviders == PROVIDER_MAX) {
+		return;
+	}
+
+	p = &d->providers[d->nproviders++];
+	*p = *provider;
+
+	/* Names end up in records without quoting, like those of monitors */
+	for (i = 0; p->name[i]; i++) {
+		if (p->name[i] <= ' ' || p->name[i] > '~' ||
+		    p->name[i] == '"' || p->name[i] == '\\') {
+			p->name[i] = '_';
+		}
+	}
+}
+
+static struct display_providers *fetch(int display)
+{
+	struct display_providers *d;
+
+	if (display < 0 || display >= ndisplays) {
+		return NULL;
+	}
+
+	d = &displays[display];
+
+	if (!d->valid && d->ctx) {
+		d->nproviders = 0;
+
+		if (context_providers(d->ctx, add_provider, d) < 0) {
+			d->nproviders = 0;
+		}
+
+		/* Don't ask again until something changes */
+		d->valid = 1;
+	}
+
+	return d;
+}
+
+void provider_update(const struct event *event)
+{
+	if (event->display >= ndisplays || in_snapshot) {
+		return;
+	}
+
+	switch (event->type) {
+	case EVENT_PROVIDER_CHANGE:
+	case EVENT_RESOURCE_CHANGE:
+		displays[event->display].valid = 0;
+		fetch(event->display);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void provider_snapshot(int display, event_cb *cb, void *data)
+{
+	struct display_providers *d;
+	struct event event;
+	int i;
+
+	if (!(d = fetch(display))) {
+		return;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.type = EVENT_PROVIDER_CHANGE;
+	event.display = display;
+	in_snapshot = 1;
+
+	for (i = 0; i < d->nproviders; i++) {
+		event.u.provider.provider = d->providers[i].provider;
+		cb(&event, data);
+	}
+
+	in_snapshot = 0;
+}
+
+const struct provider_info *provider_lookup(int display, uint32_t provider)
+{
+	struct display_providers *d;
+	int i;
+
+	if (!(d = fetch(display))) {
+		return NULL;
+	}
+
+	for (i = 0; i < d->nproviders; i++) {
+		if (d->providers[i].provider == provider) {
+			return &d->providers[i];
+		}
+	}
+
+	return NULL;
+}
+
+const struct provider_info *provider_get(int display, int n)
+{
+	struct display_providers *d;
+
+	if (!(d = fetch(display)) || n < 0 || n >= d->nproviders) {
+		return NULL;
+	}
+
+	return &d->providers[n];
+}
+
+const char *provider_capabilities(uint32_t capabilities, char *buf, size_t size)
+{
+	size_t len;
+	int i;
+
+	len = 0;
+	buf[0] = 0;
+
+	for (i = 0; i < ARRAY_SIZE(capability_names) && len < size; i++) {
+		if (capabilities & capability_names[i].mask) {
+			len += snprintf(buf + len, size - len, "%s%s",
+					len ? "," : "", capability_names[i].name);
+		}
+	}
+
+	return buf[0] ? buf : "none";
+}
@@ -0,0 +1,74 @@
+/*
+ * provider.h - Cached table of the providers of each display
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef PROVIDER_H
+#define PROVIDER_H
+
+#include <stdint.h>
+#include "backend.h"
+
+#define PROVIDER_MAX 16
+
+/* Large enough for the names of all capabilities */
+#define PROVIDER_CAPABILITIES_SIZE 64
+
+/*
+ * Start keeping track of the providers of the displays in ctxs, one for
+ * each display. The providers are fetched when they are first needed, and
+ * again whenever a provider or the set of resources changes. Returns 0 on
+ * success, or a negative error number.
+ */
+int provider_init(struct context **ctxs, int num_displays);
+void provider_free(void);
+
+/* Forget all providers of a display and use ctx from now on */
+void provider_reset(int display, struct context *ctx);
+
+/*
+ * Fetch the providers of the display of a provider or resource change
+ * event again. No other events cause a round trip.
+ */
+void provider_update(const struct event *event);
+
+/*
+ * Pass a synthetic provider change event for each provider of a display
+ * to cb, for --initial
+ */
+void provider_snapshot(int display, event_cb *cb, void *data);
+
+/*
+ * The cached description of a provider, or NULL if providers aren't
+ * tracked or the provider doesn't exist
+ */
+const struct provider_info *provider_lookup(int display, uint32_t provider);
+
+/*
+ * The nth provider of a display, for listing all of them, or NULL if
+ * there are no more
+ */
+const struct provider_info *provider_get(int display, int n);
+
+/*
+ * Describe the capabilities in a mask of RR_Capability_* as a comma-
+ * separated list, such as "source_output,sink_offload", or "none"
+ */
+const char *provider_capabilities(uint32_t capabilities, char *buf, size_t size);
+
+#endif /* PROVIDER_H */
@@ -0,0 +1,110 @@
+/*
+ * ready.c - Telling whoever started us that events are being waited for
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ready.h"
+
+#define READY_MESSAGE "READY=1"
+
+static int write_byte(int fd)
+{
+	struct sigaction ignore;
+	struct sigaction saved;
+	ssize_t written;
+	int err;
+
+	/* A launcher that stopped listening must not take us down */
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignore, &saved);
+
+	while ((written = write(fd, "\n", 1)) < 0 && errno == EINTR);
+	err = written < 0 ? -errno : 0;
+
+	sigaction(SIGPIPE, &saved, NULL);
+	close(fd);
+
+	return err;
+}
+
+/*
+ * The socket is a datagram socket in the file system, or in the abstract
+ * namespace if the name starts with an @.
+ */
+static int notify_service_manager(const char *path)
+{
+	struct sockaddr_un addr;
+	socklen_t len;
+	int err;
+	int fd;
+
+	if (!path || !*path) {
+		return 0;
+	}
+
+	if ((path[0] != '/' && path[0] != '@') || strlen(path) >= sizeof(addr.sun_path)) {
+		return -EINVAL;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	len = offsetof(struct sockaddr_un, sun_path) + strlen(path);
+
+	if (path[0] == '@') {
+		addr.sun_path[0] = 0;
+	} else {
+		len++;
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
+		return -errno;
+	}
+
+	err = sendto(fd, READY_MESSAGE, strlen(READY_MESSAGE), MSG_NOSIGNAL,
+		     (struct sockaddr*)&addr, len) < 0 ? -errno : 0;
+	close(fd);
+
+	return err;
+}
+
+int ready_notify(int fd, const char *socket)
+{
+	int err = 0;
+	int ret;
+
+	if (fd >= 0) {
+		err = write_byte(fd);
+	}
+
+	if ((ret = notify_service_manager(socket)) < 0 && !err) {
+		err = ret;
+	}
+
+	return err;
+}
@@ -0,0 +1,32 @@
+/*
+ * ready.h - Telling whoever started us that events are being waited for
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef READY_H
+#define READY_H
+
+/*
+ * Write a newline to fd and close it, unless fd is negative, and send
+ * READY=1 to the service manager listening on socket, the value of
+ * $NOTIFY_SOCKET, unless it is NULL, the way that sd_notify() does.
+ * Returns 0 on success, or the first negative error number encountered.
+ */
+int ready_notify(int fd, const char *socket);
+
+#endif /* READY_H */
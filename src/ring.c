@@ -0,0 +1,77 @@
+/*
+ * ring.c - Fixed-capacity ring of decoded events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "backend.h"
+#include "ring.h"
+
+/* Records are meant to be compact, not copies of Xlib's event union */
+typedef char event_size_check[sizeof(struct event) <= 32 ? 1 : -1];
+
+/* head and tail wrap around, so their difference is the number of events */
+#define RING_INDEX(n) ((n) & (EVENT_RING_SIZE - 1))
+
+void event_ring_init(struct event_ring *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+}
+
+static int event_ring_full(const struct event_ring *ring)
+{
+	return ring->tail - ring->head == EVENT_RING_SIZE;
+}
+
+struct event *event_ring_put(struct event_ring *ring)
+{
+	if (event_ring_full(ring)) {
+		ring->head++;
+		ring->dropped++;
+	}
+
+	return &ring->events[RING_INDEX(ring->tail++)];
+}
+
+int event_ring_get(struct event_ring *ring, struct event *event)
+{
+	if (ring->head == ring->tail) {
+		return 0;
+	}
+
+	*event = ring->events[RING_INDEX(ring->head++)];
+
+	return 1;
+}
+
+int event_ring_empty(const struct event_ring *ring)
+{
+	return ring->head == ring->tail;
+}
+
+unsigned long event_ring_dropped(struct event_ring *ring)
+{
+	unsigned long dropped = ring->dropped;
+
+	ring->dropped = 0;
+
+	return dropped;
+}
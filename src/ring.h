@@ -0,0 +1,60 @@
+/*
+ * ring.h - Fixed-capacity ring of decoded events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include "backend.h"
+
+/*
+ * Capacity of a ring, a power of two. This bounds the size of a batch,
+ * and the memory held for events that haven't been handled yet.
+ */
+#define EVENT_RING_SIZE 512
+
+/*
+ * Events are decoded straight into the ring, which is part of the
+ * context and allocated along with it, so no memory is allocated per
+ * event. If the ring is full, the oldest event is dropped.
+ */
+struct event_ring {
+	struct event events[EVENT_RING_SIZE];
+	unsigned int head;
+	unsigned int tail;
+	unsigned long dropped;
+};
+
+void event_ring_init(struct event_ring *ring);
+
+/*
+ * Slot for a new event at the end of the ring. If the ring is full, the
+ * oldest event is dropped to make room for it.
+ */
+struct event *event_ring_put(struct event_ring *ring);
+
+/* Take the oldest event from the ring. Returns 1 on success, 0 if empty. */
+int event_ring_get(struct event_ring *ring, struct event *event);
+
+int event_ring_empty(const struct event_ring *ring);
+
+/* Number of events dropped since the last call */
+unsigned long event_ring_dropped(struct event_ring *ring);
+
+#endif /* RING_H */
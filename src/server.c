@@ -0,0 +1,355 @@
+/*
+ * server.c - Broadcast events to clients on a Unix domain socket
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "backend.h"
+#include "output.h"
+#include "server.h"
+
+#define RING_SIZE 65536
+
+struct client {
+	int fd;
+	size_t head;
+	size_t len;
+	char ring[RING_SIZE];
+};
+
+static struct {
+	int fd;
+	struct sockaddr_un addr;
+	char hello[OUTPUT_RECORD_MAX];
+	size_t hello_len;
+	struct client *clients[SERVER_MAX_CLIENTS];
+	int nclients;
+} server = {
+	.fd = -1
+};
+
+static int set_nonblock_cloexec(int fd)
+{
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+	    fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+/* The greeting tells clients how to name the sources of records */
+static void make_hello(const char *const *displays, int ndisplays)
+{
+	struct record_header header;
+	size_t len;
+	int i;
+
+	len = sizeof(header);
+
+	for (i = 0; i < ndisplays; i++) {
+		size_t name_len = strlen(displays[i]) + 1;
+
+		if (len + name_len > sizeof(server.hello)) {
+			break;
+		}
+
+		memcpy(server.hello + len, displays[i], name_len);
+		len += name_len;
+	}
+
+	header.length = len;
+	header.type = RECORD_HELLO;
+	header.source = i;
+	memcpy(server.hello, &header, sizeof(header));
+	server.hello_len = len;
+}
+
+/*
+ * If the address is in use, find out if somebody is still listening on
+ * it. Nobody cleans up after a server that was killed, so a socket that
+ * refuses connections can be replaced.
+ */
+static int bind_socket(void)
+{
+	int probe;
+	int err;
+
+	if (bind(server.fd, (struct sockaddr*)&server.addr, sizeof(server.addr)) == 0) {
+		return 0;
+	}
+
+	if (errno != EADDRINUSE) {
+		return -errno;
+	}
+
+	if ((probe = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -errno;
+	}
+
+	err = connect(probe, (struct sockaddr*)&server.addr, sizeof(server.addr));
+	close(probe);
+
+	if (err == 0 || errno != ECONNREFUSED) {
+		return -EADDRINUSE;
+	}
+
+	unlink(server.addr.sun_path);
+
+	if (bind(server.fd, (struct sockaddr*)&server.addr, sizeof(server.addr)) < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+int server_init(const char *path, const char *const *displays, int ndisplays)
+{
+	int err;
+
+	if (strlen(path) >= sizeof(server.addr.sun_path)) {
+		return -ENAMETOOLONG;
+	}
+
+	memset(&server.addr, 0, sizeof(server.addr));
+	server.addr.sun_family = AF_UNIX;
+	strcpy(server.addr.sun_path, path);
+
+	if ((server.fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -errno;
+	}
+
+	if ((err = set_nonblock_cloexec(server.fd)) < 0 ||
+	    (err = bind_socket()) < 0) {
+		close(server.fd);
+		server.fd = -1;
+		return err;
+	}
+
+	if (listen(server.fd, SOMAXCONN) < 0) {
+		err = -errno;
+		server_free();
+		return err;
+	}
+
+	make_hello(displays, ndisplays);
+
+	return 0;
+}
+
+static void drop_client(int i)
+{
+	struct client *client = server.clients[i];
+
+	DBG(fprintf(stderr, "Dropping client %d\n", client->fd));
+	close(client->fd);
+	free(client);
+
+	server.clients[i] = server.clients[--server.nclients];
+}
+
+void server_free(void)
+{
+	while (server.nclients > 0) {
+		drop_client(server.nclients - 1);
+	}
+
+	if (server.fd >= 0) {
+		close(server.fd);
+		unlink(server.addr.sun_path);
+		server.fd = -1;
+	}
+}
+
+/* Returns 0 if the data was queued, or -ENOBUFS if the ring is full */
+static int client_queue(struct client *client, const void *data, size_t len)
+{
+	size_t tail;
+	size_t first;
+
+	if (RING_SIZE - client->len < len) {
+		return -ENOBUFS;
+	}
+
+	tail = (client->head + client->len) % RING_SIZE;
+	first = RING_SIZE - tail < len ? RING_SIZE - tail : len;
+
+	memcpy(client->ring + tail, data, first);
+	memcpy(client->ring, (const char*)data + first, len - first);
+	client->len += len;
+
+	return 0;
+}
+
+/* Returns 0 on success or if the client isn't ready, or a negative error */
+static int client_flush(struct client *client)
+{
+	struct msghdr msg;
+	struct iovec iov[2];
+	ssize_t written;
+	size_t first;
+
+	while (client->len > 0) {
+		first = RING_SIZE - client->head;
+
+		if (first > client->len) {
+			first = client->len;
+		}
+
+		iov[0].iov_base = client->ring + client->head;
+		iov[0].iov_len = first;
+		iov[1].iov_base = client->ring;
+		iov[1].iov_len = client->len - first;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iov[1].iov_len ? 2 : 1;
+
+		/* MSG_NOSIGNAL, so that a client going away doesn't raise SIGPIPE */
+		if ((written = sendmsg(client->fd, &msg, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+		}
+
+		client->head = (client->head + written) % RING_SIZE;
+		client->len -= written;
+	}
+
+	client->head = 0;
+
+	return 0;
+}
+
+static void accept_clients(void)
+{
+	struct client *client;
+	int fd;
+
+	while ((fd = accept(server.fd, NULL, NULL)) >= 0) {
+		if (server.nclients == SERVER_MAX_CLIENTS ||
+		    set_nonblock_cloexec(fd) < 0 ||
+		    !(client = malloc(sizeof(*client)))) {
+			close(fd);
+			continue;
+		}
+
+		client->fd = fd;
+		client->head = 0;
+		client->len = 0;
+		client_queue(client, server.hello, server.hello_len);
+
+		server.clients[server.nclients++] = client;
+		DBG(fprintf(stderr, "Accepted client %d\n", fd));
+	}
+}
+
+void server_broadcast(const struct event *event)
+{
+	char rec[OUTPUT_RECORD_MAX];
+	size_t len;
+	int i;
+
+	if (server.fd < 0 || !(len = output_encode(event, rec, sizeof(rec)))) {
+		return;
+	}
+
+	for (i = server.nclients - 1; i >= 0; i--) {
+		if (client_queue(server.clients[i], rec, len) < 0) {
+			drop_client(i);
+		}
+	}
+}
+
+void server_flush(void)
+{
+	int i;
+
+	for (i = server.nclients - 1; i >= 0; i--) {
+		if (client_flush(server.clients[i]) < 0) {
+			drop_client(i);
+		}
+	}
+}
+
+int server_pollfds(struct pollfd *fds, int max)
+{
+	int n;
+	int i;
+
+	if (server.fd < 0 || max < 1) {
+		return 0;
+	}
+
+	fds[0].fd = server.fd;
+	fds[0].events = POLLIN;
+
+	/* Clients never send anything, so POLLIN means they went away */
+	for (n = 1, i = 0; i < server.nclients && n < max; i++, n++) {
+		fds[n].fd = server.clients[i]->fd;
+		fds[n].events = POLLIN | (server.clients[i]->len ? POLLOUT : 0);
+	}
+
+	return n;
+}
+
+void server_handle(const struct pollfd *fds, int nfds)
+{
+	char buf[256];
+	int n;
+	int i;
+
+	if (nfds < 1) {
+		return;
+	}
+
+	/* Fds are in the same order as the clients until one is dropped */
+	for (n = nfds - 1; n > 0; n--) {
+		i = n - 1;
+
+		if (i >= server.nclients || server.clients[i]->fd != fds[n].fd) {
+			continue;
+		}
+
+		if (fds[n].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) {
+			ssize_t len = read(fds[n].fd, buf, sizeof(buf));
+
+			if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+				drop_client(i);
+			}
+		}
+	}
+
+	if (fds[0].revents & POLLIN) {
+		accept_clients();
+	}
+
+	server_flush();
+}
@@ -0,0 +1,57 @@
+/*
+ * server.h - Broadcast events to clients on a Unix domain socket
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <poll.h>
+#include "backend.h"
+
+#define SERVER_MAX_CLIENTS 64
+
+/*
+ * Listen for clients on the Unix domain socket at path. A stale socket
+ * left behind by a previous server is replaced. Clients are greeted with
+ * the names of the ndisplays displays, followed by a binary record for
+ * every event that is passed to server_broadcast().
+ */
+int server_init(const char *path, const char *const *displays, int ndisplays);
+void server_free(void);
+
+/*
+ * Queue the record for an event in the ring buffer of every client. A
+ * client that has fallen so far behind that its buffer overflows is
+ * disconnected.
+ */
+void server_broadcast(const struct event *event);
+
+/* Write as much of the queued data to the clients as they will accept */
+void server_flush(void);
+
+/*
+ * Fill fds with the descriptors that the server needs to be woken up for.
+ * Returns the number of entries used, at most max.
+ */
+int server_pollfds(struct pollfd *fds, int max);
+
+/* Accept new clients and handle disconnects reported by poll() */
+void server_handle(const struct pollfd *fds, int nfds);
+
+#endif /* SERVER_H */
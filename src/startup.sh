@@ -0,0 +1,126 @@
+#!/bin/sh
+#
+# startup.sh - Measure how fast builds of xrandrwait start waiting for events
+# Copyright (C) 2025 Matthias Kruk
+#
+# Xrandrwait is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published
+# by the Free Software Foundation; either version 3, or (at your
+# option) any later version.
+#
+# Xrandrwait is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with xrandrwait; see the file COPYING.  If not, write to the
+# Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+# Boston, MA 02111-1307, USA.
+#
+# Usage: startup.sh XRANDRWAIT...
+#
+# Starts each XRANDRWAIT repeatedly and reports the time from exec until
+# it signals readiness on --ready-fd, the time it measured itself with
+# --time-startup, its peak RSS, and the size of the binary. Medians are
+# taken over BENCH_RUNS runs. The builds connect to $DISPLAY, or to a
+# temporary Xvfb server on BENCH_DISPLAY if DISPLAY isn't set.
+
+runs="${BENCH_RUNS:-50}"
+display="${BENCH_DISPLAY:-:99}"
+xvfb=
+
+tmpdir=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmpdir"; if [ -n "$xvfb" ]; then kill "$xvfb"; fi' EXIT
+
+now_us() {
+	echo $(( $(date +%s%N) / 1000 ))
+}
+
+start_xvfb() {
+	if ! command -v Xvfb >/dev/null || ! command -v xrandr >/dev/null; then
+		echo "Xvfb and xrandr are needed without a DISPLAY" 1>&2
+		return 1
+	fi
+
+	Xvfb "$display" -screen 0 1024x768x24 -nolisten tcp >/dev/null 2>&1 &
+	xvfb=$!
+
+	for i in $(seq 50); do
+		if xrandr -d "$display" >/dev/null 2>&1; then
+			DISPLAY="$display"
+			export DISPLAY
+			return 0
+		fi
+
+		sleep 0.1
+	done
+
+	echo "Xvfb did not start on $display" 1>&2
+	return 1
+}
+
+median() {
+	sort -n "$1" | awk '{ v[NR] = $1 } END { print NR ? v[int((NR + 1) / 2)] : "-" }'
+}
+
+# Start xrandrwait once and append its figures to the files in $tmpdir
+run_once() {
+	rm -f "$tmpdir/ready"
+	mkfifo "$tmpdir/ready" || return 1
+
+	start=$(now_us)
+	"$1" --monitor --quiet --time-startup --ready-fd 3 \
+	     3>"$tmpdir/ready" 2>"$tmpdir/stderr" &
+	pid=$!
+
+	if ! read -r line < "$tmpdir/ready"; then
+		wait "$pid"
+		return 1
+	fi
+
+	echo $(( $(now_us) - start )) >> "$tmpdir/exec"
+	awk '/^VmHWM:/ { print $2 }' "/proc/$pid/status" >> "$tmpdir/rss"
+
+	kill "$pid"
+	wait "$pid"
+
+	sed -n -e 's/^startup:.* total=\([0-9]*\) us.*/\1/p' "$tmpdir/stderr" >> "$tmpdir/self"
+	return 0
+}
+
+if [ "$#" -eq 0 ]; then
+	echo "Usage: $0 XRANDRWAIT..." 1>&2
+	exit 1
+fi
+
+if [ -z "$DISPLAY" ] && ! start_xvfb; then
+	exit 1
+fi
+
+printf "%-24s %10s %10s %10s %10s\n" "build" "exec (us)" "self (us)" "rss (kB)" "size (B)"
+
+for xrandrwait in "$@"; do
+	rm -f "$tmpdir/exec" "$tmpdir/self" "$tmpdir/rss"
+
+	# The first run only warms up the page cache
+	if ! run_once "$xrandrwait"; then
+		echo "Could not start $xrandrwait" 1>&2
+		exit 1
+	fi
+
+	rm -f "$tmpdir/exec" "$tmpdir/self" "$tmpdir/rss"
+
+	for i in $(seq "$runs"); do
+		if ! run_once "$xrandrwait"; then
+			echo "Could not start $xrandrwait" 1>&2
+			exit 1
+		fi
+	done
+
+	printf "%-24s %10s %10s %10s %10s\n" "$(basename "$xrandrwait")" \
+	       "$(median "$tmpdir/exec")" "$(median "$tmpdir/self")" \
+	       "$(median "$tmpdir/rss")" "$(wc -c < "$xrandrwait")"
+done
+
+exit 0
@@ -0,0 +1,195 @@
+/*
+ * state.c - Cached state of the CRTCs and outputs
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include "backend.h"
+#include "state.h"
+#include "xid_table.h"
+
+struct entry {
+	uint32_t xid;
+	struct event event;
+};
+
+/* XIDs are allocated by the server, so each display needs its own tables */
+struct display_state {
+	struct xid_table crtcs;
+	struct xid_table outputs;
+	struct event screens[MAX_SCREENS];
+};
+
+static struct display_state displays[MAX_DISPLAYS];
+static int ndisplays;
+
+int state_init(int num_displays)
+{
+	int err;
+	int i;
+
+	if (num_displays <= 0 || num_displays > MAX_DISPLAYS) {
+		return -EINVAL;
+	}
+
+	for (ndisplays = 0; ndisplays < num_displays; ndisplays++) {
+		struct display_state *d = &displays[ndisplays];
+
+		if ((err = xid_table_init(&d->crtcs, sizeof(struct entry))) < 0 ||
+		    (err = xid_table_init(&d->outputs, sizeof(struct entry))) < 0) {
+			xid_table_free(&d->crtcs);
+			state_free();
+			return err;
+		}
+
+		for (i = 0; i < MAX_SCREENS; i++) {
+			d->screens[i].type = EVENT_OTHER;
+		}
+	}
+
+	return 0;
+}
+
+void state_free(void)
+{
+	while (ndisplays > 0) {
+		ndisplays--;
+		xid_table_free(&displays[ndisplays].crtcs);
+		xid_table_free(&displays[ndisplays].outputs);
+	}
+}
+
+void state_reset(int display)
+{
+	struct display_state *d;
+	int i;
+
+	if (display < 0 || display >= ndisplays) {
+		return;
+	}
+
+	d = &displays[display];
+	xid_table_clear(&d->crtcs);
+	xid_table_clear(&d->outputs);
+
+	for (i = 0; i < MAX_SCREENS; i++) {
+		d->screens[i].type = EVENT_OTHER;
+	}
+}
+
+static int screen_equal(const struct event *a, const struct event *b)
+{
+	return a->u.screen.width == b->u.screen.width &&
+	       a->u.screen.height == b->u.screen.height &&
+	       a->u.screen.mwidth == b->u.screen.mwidth &&
+	       a->u.screen.mheight == b->u.screen.mheight &&
+	       a->u.screen.rotation == b->u.screen.rotation;
+}
+
+static int crtc_equal(const struct event *a, const struct event *b)
+{
+	return a->u.crtc.mode == b->u.crtc.mode &&
+	       a->u.crtc.rotation == b->u.crtc.rotation &&
+	       a->u.crtc.x == b->u.crtc.x &&
+	       a->u.crtc.y == b->u.crtc.y &&
+	       a->u.crtc.width == b->u.crtc.width &&
+	       a->u.crtc.height == b->u.crtc.height;
+}
+
+static int output_equal(const struct event *a, const struct event *b)
+{
+	return a->u.output.crtc == b->u.output.crtc &&
+	       a->u.output.mode == b->u.output.mode &&
+	       a->u.output.rotation == b->u.output.rotation &&
+	       a->u.output.connection == b->u.output.connection;
+}
+
+/* Return the cached event that has the same key as event */
+static struct event *state_get(const struct event *event)
+{
+	struct display_state *d;
+	struct entry *entry;
+
+	if (event->display >= ndisplays || event->screen >= MAX_SCREENS) {
+		return NULL;
+	}
+
+	d = &displays[event->display];
+
+	switch (event->type) {
+	case EVENT_SCREEN_CHANGE:
+		return &d->screens[event->screen];
+
+	case EVENT_CRTC_CHANGE:
+		entry = xid_table_get(&d->crtcs, event->u.crtc.crtc);
+		break;
+
+	case EVENT_OUTPUT_CHANGE:
+		entry = xid_table_get(&d->outputs, event->u.output.output);
+		break;
+
+	default:
+		return NULL;
+	}
+
+	return entry ? &entry->event : NULL;
+}
+
+void state_seed(const struct event *event, void *data)
+{
+	struct event *cached;
+
+	if ((cached = state_get(event))) {
+		*cached = *event;
+	}
+}
+
+int state_update(const struct event *event)
+{
+	struct event *cached;
+	int changed;
+
+	/* Err on the side of reporting events that can't be tracked */
+	if (!(cached = state_get(event))) {
+		return 1;
+	}
+
+	switch (event->type) {
+	case EVENT_SCREEN_CHANGE:
+		changed = cached->type != event->type || !screen_equal(cached, event);
+		break;
+
+	case EVENT_CRTC_CHANGE:
+		changed = cached->type != event->type || !crtc_equal(cached, event);
+		break;
+
+	case EVENT_OUTPUT_CHANGE:
+		changed = cached->type != event->type || !output_equal(cached, event);
+		break;
+
+	default:
+		changed = 0;
+		break;
+	}
+
+	*cached = *event;
+
+	return changed;
+}
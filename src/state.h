@@ -0,0 +1,46 @@
+/*
+ * state.h - Cached state of the CRTCs and outputs
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef STATE_H
+#define STATE_H
+
+#include "backend.h"
+
+/*
+ * The state is a table of the most recent event for each CRTC and output,
+ * keyed by XID, plus the most recent screen change event of each screen.
+ * There is one such state for each of the num_displays displays.
+ */
+int state_init(int num_displays);
+void state_free(void);
+
+/* Forget everything about a display */
+void state_reset(int display);
+
+/* Record an event without checking whether it changes anything */
+void state_seed(const struct event *event, void *data);
+
+/*
+ * Apply an event to the state. Returns 1 if the event changed the state
+ * or could not be tracked, and 0 if it did not change anything.
+ */
+int state_update(const struct event *event);
+
+#endif /* STATE_H */
@@ -0,0 +1,328 @@
+/*
+ * stats.c - Statistics about the events handled by xrandrwait
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "backend.h"
+#include "output.h"
+#include "stats.h"
+
+/* Bucket i counts the values greater than 2^(i-1) and at most 2^i */
+#define HIST_BUCKETS 24
+
+struct histogram {
+	unsigned long count[HIST_BUCKETS];
+	unsigned long samples;
+	long long sum;
+	long long min;
+	long long max;
+};
+
+static struct {
+	int enabled;
+	const char *path;
+	long long start;
+
+	unsigned long received[EVENT_TYPES];
+	unsigned long dropped;
+	unsigned long reported;
+	unsigned long records_dropped;
+	unsigned long wakeups;
+
+	/*
+	 * Server timestamps have an unknown offset from our clock, so the
+	 * smallest difference seen so far is taken to be no delay at all.
+	 */
+	long long min_offset;
+	int have_offset;
+
+	/*
+	 * Receive time of the most recent event, and of the event that the
+	 * oldest record that hasn't been written yet was made for. Records
+	 * of a burst are made for the last event of the burst.
+	 */
+	long long last_received;
+	long long pending_since;
+	int pending;
+
+	struct histogram batches;
+	struct histogram server_latency;
+	struct histogram write_latency;
+} stats;
+
+static long long monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void histogram_add(struct histogram *hist, long long value)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS - 1 && value > (1LL << i); i++);
+
+	if (!hist->samples || value < hist->min) {
+		hist->min = value;
+	}
+
+	if (!hist->samples || value > hist->max) {
+		hist->max = value;
+	}
+
+	hist->count[i]++;
+	hist->samples++;
+	hist->sum += value;
+}
+
+/* Upper bound of the bucket that contains the given percentile */
+static long long histogram_percentile(const struct histogram *hist, int percentile)
+{
+	unsigned long seen;
+	unsigned long rank;
+	int i;
+
+	rank = (hist->samples * percentile + 99) / 100;
+
+	for (seen = 0, i = 0; i < HIST_BUCKETS - 1; i++) {
+		if ((seen += hist->count[i]) >= rank) {
+			break;
+		}
+	}
+
+	return (1LL << i) < hist->max ? 1LL << i : hist->max;
+}
+
+static void histogram_print(FILE *file, const char *title, const struct histogram *hist)
+{
+	int i;
+
+	if (!hist->samples) {
+		fprintf(file, "%s: no samples\n", title);
+		return;
+	}
+
+	fprintf(file, "%s: min %lld avg %lld p50 %lld p99 %lld max %lld\n", title,
+		hist->min, hist->sum / (long long)hist->samples,
+		histogram_percentile(hist, 50), histogram_percentile(hist, 99),
+		hist->max);
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (hist->count[i]) {
+			fprintf(file, "  %s%9lld: %lu\n", i < HIST_BUCKETS - 1 ? "<=" : "> ",
+				i < HIST_BUCKETS - 1 ? 1LL << i : 1LL << (i - 1),
+				hist->count[i]);
+		}
+	}
+}
+
+/*
+ * Returns 1 if the event carries a server timestamp. CRTC and output
+ * changes have one on the wire, but it isn't part of struct event, so
+ * they never count towards the server latency, which the dump says.
+ */
+static int event_timestamp(const struct event *event, uint32_t *timestamp)
+{
+	switch (event->type) {
+	case EVENT_SCREEN_CHANGE:
+		*timestamp = event->u.screen.timestamp;
+		return 1;
+
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		*timestamp = event->u.property.timestamp;
+		return 1;
+
+	case EVENT_PROVIDER_CHANGE:
+		*timestamp = event->u.provider.timestamp;
+		return 1;
+
+	case EVENT_RESOURCE_CHANGE:
+		*timestamp = event->u.resource.timestamp;
+		return 1;
+
+	case EVENT_LEASE:
+		*timestamp = event->u.lease.timestamp;
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+void stats_init(const char *path)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.enabled = 1;
+	stats.path = path;
+	stats.start = monotonic_us();
+	stats.last_received = stats.start;
+}
+
+void stats_wakeup(void)
+{
+	if (stats.enabled) {
+		stats.wakeups++;
+	}
+}
+
+void stats_received(const struct event *event)
+{
+	uint32_t timestamp;
+	long long now;
+
+	if (!stats.enabled) {
+		return;
+	}
+
+	now = monotonic_us();
+
+	if (event->type >= 0 && event->type < EVENT_TYPES) {
+		stats.received[event->type]++;
+	}
+
+	/* Timestamps of zero come from synthetic events */
+	if (event_timestamp(event, &timestamp) && timestamp) {
+		long long offset = now / 1000 - timestamp;
+
+		if (!stats.have_offset || offset < stats.min_offset) {
+			stats.min_offset = offset;
+			stats.have_offset = 1;
+		}
+
+		histogram_add(&stats.server_latency, (offset - stats.min_offset) * 1000);
+	}
+
+	stats.last_received = now;
+}
+
+void stats_batch(int events)
+{
+	if (stats.enabled && events > 0) {
+		histogram_add(&stats.batches, events);
+	}
+}
+
+void stats_dropped(unsigned long events)
+{
+	if (stats.enabled) {
+		stats.dropped += events;
+	}
+}
+
+void stats_records_dropped(unsigned long records)
+{
+	if (stats.enabled) {
+		stats.records_dropped += records;
+	}
+}
+
+void stats_reported(void)
+{
+	if (!stats.enabled) {
+		return;
+	}
+
+	if (!stats.pending) {
+		stats.pending_since = stats.last_received;
+		stats.pending = 1;
+	}
+
+	stats.reported++;
+}
+
+void stats_written(void)
+{
+	if (stats.enabled && stats.pending) {
+		histogram_add(&stats.write_latency, monotonic_us() - stats.pending_since);
+		stats.pending = 0;
+	}
+}
+
+int stats_dump(void)
+{
+	unsigned long received;
+	struct rusage usage;
+	long long elapsed;
+	long long cpu;
+	FILE *file;
+	int i;
+
+	if (!stats.enabled) {
+		return 0;
+	}
+
+	if (!stats.path) {
+		file = stderr;
+	} else if (!(file = fopen(stats.path, "w"))) {
+		return -errno;
+	}
+
+	elapsed = monotonic_us() - stats.start;
+
+	fprintf(file, "elapsed: %lld.%03lld s\n", elapsed / 1000000, elapsed / 1000 % 1000);
+
+	fprintf(file, "events:");
+	for (received = 0, i = 0; i < EVENT_TYPES; i++) {
+		if (stats.received[i]) {
+			fprintf(file, " %s=%lu", event_name(i), stats.received[i]);
+			received += stats.received[i];
+		}
+	}
+	fprintf(file, "\n");
+
+	fprintf(file, "received: %lu (%.2f/s)\n", received,
+		elapsed > 0 ? received * 1000000.0 / elapsed : 0.0);
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		cpu = (long long)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+			usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+
+		fprintf(file, "cpu: %lld us (%.2f us/event)\n", cpu,
+			received ? (double)cpu / received : 0.0);
+	}
+
+	fprintf(file, "dropped: %lu\n", stats.dropped);
+	fprintf(file, "records: %lu\n", stats.reported);
+	fprintf(file, "records dropped: %lu\n", stats.records_dropped);
+	fprintf(file, "wakeups: %lu (%.2f/s)\n", stats.wakeups,
+		elapsed > 0 ? stats.wakeups * 1000000.0 / elapsed : 0.0);
+
+	histogram_print(file, "batch size (events)", &stats.batches);
+	fprintf(file, "server latency measured: %lu of %lu events "
+		"(those with a timestamp; not crtc_change and output_change)\n",
+		stats.server_latency.samples, received);
+	histogram_print(file, "server latency (us)", &stats.server_latency);
+	histogram_print(file, "write latency (us)", &stats.write_latency);
+
+	if (file == stderr) {
+		return fflush(file) == EOF ? -errno : 0;
+	}
+
+	return fclose(file) == EOF ? -errno : 0;
+}
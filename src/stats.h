@@ -0,0 +1,65 @@
+/*
+ * stats.h - Statistics about the events handled by xrandrwait
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "backend.h"
+
+/*
+ * Start collecting statistics. They are written to the file at path, or
+ * to standard error if path is NULL. Until this is called, all other
+ * functions do nothing.
+ */
+void stats_init(const char *path);
+
+/* Count a return from poll() */
+void stats_wakeup(void);
+
+/* Count an event as it is received from the connection */
+void stats_received(const struct event *event);
+
+/* Record the number of events that were drained in one batch */
+void stats_batch(int events);
+
+/* Count events that the backend had to drop */
+void stats_dropped(unsigned long events);
+
+/* Count records that the output had to drop */
+void stats_records_dropped(unsigned long records);
+
+/* Count a record that was passed to the output */
+void stats_reported(void);
+
+/*
+ * Note that all records reported so far have been written. The time since
+ * the event that the oldest of them was made for is recorded as the write
+ * latency. Call this only when output_written() says that records were
+ * actually written, not whenever the output was supposed to be flushed.
+ */
+void stats_written(void);
+
+/*
+ * Write the statistics collected so far. Returns 0 on success, or a
+ * negative error number.
+ */
+int stats_dump(void);
+
+#endif /* STATS_H */
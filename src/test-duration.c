@@ -0,0 +1,60 @@
+/*
+ * test-duration.c - Tests for parsing durations
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include "duration.h"
+
+static int expect(const char *str, long unit, int expected, long expected_ms)
+{
+	long ms = -1;
+	int err;
+
+	if ((err = duration_parse(str, unit, &ms)) != expected ||
+	    (!err && ms != expected_ms)) {
+		fprintf(stderr, "FAIL: expected %d and %ld for \"%s\", got %d and %ld\n",
+			expected, expected_ms, str, err, ms);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int failed;
+
+	failed = expect("10", 1, 0, 10);
+	failed += expect("10", 1000, 0, 10000);
+	failed += expect("0", 1000, 0, 0);
+	failed += expect("250ms", 1000, 0, 250);
+	failed += expect("2s", 1, 0, 2000);
+
+	failed += expect("", 1, -EINVAL, 0);
+	failed += expect("ms", 1, -EINVAL, 0);
+	failed += expect("-1", 1, -EINVAL, 0);
+	failed += expect("5m", 1, -EINVAL, 0);
+	failed += expect("10sx", 1, -EINVAL, 0);
+	failed += expect("10 s", 1, -EINVAL, 0);
+	failed += expect("99999999999999999999", 1, -ERANGE, 0);
+	failed += expect("9223372036854775807s", 1, -ERANGE, 0);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * test-filter.c - Tests for event filters
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "filter.h"
+#include "names.h"
+#include "monitor.h"
+#include "provider.h"
+
+/*
+ * Names are looked up by the filters and the formatter that the filters
+ * take event and field names from, so the lookups are stubbed.
+ */
+const char *names_output(int display, uint32_t output_id)
+{
+	return output_id == 0x42 ? "DP-1" : NULL;
+}
+
+const char *names_mode(int display, uint32_t mode)
+{
+	return mode == 0x50 ? "1920x1080@60.00" : "1920x1080@59.94";
+}
+
+const char *names_atom(int display, uint32_t atom_id)
+{
+	return atom_id == 0x100 ? "EDID" : NULL;
+}
+
+const struct monitor_info *monitor_lookup(int display, uint32_t output)
+{
+	return NULL;
+}
+
+const struct provider_info *provider_lookup(int display, uint32_t provider)
+{
+	return NULL;
+}
+
+const struct provider_info *provider_get(int display, int n)
+{
+	return NULL;
+}
+
+const char *provider_capabilities(uint32_t capabilities, char *buf, size_t size)
+{
+	return "";
+}
+
+static int expect_add(const char *spec, int expected)
+{
+	int err;
+
+	filter_free();
+
+	if ((err = filter_add(spec)) != expected) {
+		fprintf(stderr, "FAIL: expected %d for filter \"%s\", got %d\n",
+			expected, spec, err);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int expect_match(const char *spec, const struct event *event, int expected)
+{
+	int match;
+
+	if (expect_add(spec, 0)) {
+		return 1;
+	}
+
+	if ((match = filter_match(event)) != expected) {
+		fprintf(stderr, "FAIL: expected %d for filter \"%s\", got %d\n",
+			expected, spec, match);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct event output_change;
+	struct event crtc_change;
+	int failed;
+	int i;
+
+	memset(&output_change, 0, sizeof(output_change));
+	output_change.type = EVENT_OUTPUT_CHANGE;
+	output_change.u.output.output = 0x42;
+	output_change.u.output.mode = 0x50;
+	output_change.u.output.connection = RR_Connected;
+	output_change.u.output.rotation = RR_Rotate_0;
+
+	memset(&crtc_change, 0, sizeof(crtc_change));
+	crtc_change.type = EVENT_CRTC_CHANGE;
+	crtc_change.u.crtc.crtc = 0x60;
+	crtc_change.u.crtc.mode = 0x51;
+	crtc_change.u.crtc.width = 1920;
+	crtc_change.u.crtc.height = 1080;
+	crtc_change.u.crtc.rotation = RR_Rotate_90 | RR_Reflect_X;
+
+	failed = expect_add("event=output_change,connection=Y", 0);
+	failed += expect_add("width>=1920,height<1200,x!=-1", 0);
+	failed += expect_add("output=0x42,crtc=96,property=EDID", 0);
+
+	/* Unknown fields, operators, and values */
+	failed += expect_add("", -EINVAL);
+	failed += expect_add("foo=1", -EINVAL);
+	failed += expect_add("width~1920", -EINVAL);
+	failed += expect_add("width", -EINVAL);
+	failed += expect_add("width=", -EINVAL);
+	failed += expect_add("width=1920px", -EINVAL);
+	failed += expect_add("event=nothing", -EINVAL);
+	failed += expect_add("connection=Q", -EINVAL);
+	failed += expect_add("rotation=45", -EINVAL);
+	failed += expect_add("output=", -EINVAL);
+	failed += expect_add("crtc=HDMI-1", -EINVAL);
+	failed += expect_add("provider=modesetting", -EINVAL);
+
+	/* Names and enumerations can't be ordered */
+	failed += expect_add("output<DP-1", -EINVAL);
+	failed += expect_add("rotation>=90", -EINVAL);
+	failed += expect_add("x=1,y=1,x=1,y=1,x=1,y=1,x=1,y=1,x=1", -E2BIG);
+
+	filter_free();
+
+	for (i = 0; i < 16; i++) {
+		failed += filter_add("x=1") != 0;
+	}
+
+	if (filter_add("x=1") != -E2BIG) {
+		fprintf(stderr, "FAIL: more than 16 filters were accepted\n");
+		failed++;
+	}
+
+	failed += expect_match("event=output_change,connection=Y", &output_change, 1);
+	failed += expect_match("event=output_change,connection=N", &output_change, 0);
+	failed += expect_match("output=DP-1", &output_change, 1);
+	failed += expect_match("output!=DP-1", &output_change, 0);
+	failed += expect_match("output=0x42", &output_change, 1);
+	failed += expect_match("output=DP-2", &output_change, 0);
+	failed += expect_match("output=DP-1", &crtc_change, 0);
+	failed += expect_match("width>=1920,height<1200", &crtc_change, 1);
+	failed += expect_match("width>1920", &crtc_change, 0);
+	failed += expect_match("rotation=90,reflection=X", &crtc_change, 1);
+	failed += expect_match("rotation=0", &crtc_change, 0);
+
+	/* Modes match with or without their refresh rate */
+	failed += expect_match("mode=1920x1080@60.00", &output_change, 1);
+	failed += expect_match("mode=1920x1080@59.94", &output_change, 0);
+	failed += expect_match("mode=1920x1080", &output_change, 1);
+	failed += expect_match("mode=1920x1080", &crtc_change, 1);
+	failed += expect_match("mode!=1920x1080", &crtc_change, 0);
+	failed += expect_match("mode=1920x108", &output_change, 0);
+	failed += expect_match("mode=1920x1080@60", &output_change, 0);
+
+	filter_free();
+
+	return failed ? 1 : 0;
+}
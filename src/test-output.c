@@ -0,0 +1,166 @@
+/*
+ * test-output.c - Tests for the record formatter
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <X11/X.h>
+#include "output.h"
+#include "names.h"
+#include "monitor.h"
+#include "provider.h"
+
+/*
+ * The formatter is tested on its own, so the lookups that it depends on
+ * are replaced with stubs that return names the X server might send.
+ */
+static const char *atom = "EDID\"\\\t";
+static const char *output = "DP-\"1\"";
+
+const char *names_output(int display, uint32_t output_id)
+{
+	return output;
+}
+
+const char *names_mode(int display, uint32_t mode)
+{
+	return "1920x1080";
+}
+
+const char *names_atom(int display, uint32_t atom_id)
+{
+	return atom;
+}
+
+const struct monitor_info *monitor_lookup(int display, uint32_t output)
+{
+	return NULL;
+}
+
+const struct provider_info *provider_lookup(int display, uint32_t provider)
+{
+	return NULL;
+}
+
+const struct provider_info *provider_get(int display, int n)
+{
+	return NULL;
+}
+
+const char *provider_capabilities(uint32_t capabilities, char *buf, size_t size)
+{
+	return "";
+}
+
+static int expect(const struct event *event, const char *expected)
+{
+	const char *record;
+	size_t len;
+
+	if (!output_event(event)) {
+		fprintf(stderr, "FAIL: no record for event %d\n", event->type);
+		return 1;
+	}
+
+	record = output_record(&len);
+
+	if (len != strlen(expected) || memcmp(record, expected, len)) {
+		fprintf(stderr, "FAIL: expected %s       got %.*s", expected, (int)len, record);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * A burst whose records don't fit into OUTPUT_RECORD_MAX must still end
+ * with a terminator and say how many records were left out
+ */
+static int expect_truncated_burst(enum output_format format, const char *begin,
+				  const char *end)
+{
+	static struct event events[64];
+	char name[512];
+	const char *record;
+	size_t len;
+	int i;
+
+	memset(name, '"', sizeof(name) - 1);
+	name[sizeof(name) - 1] = 0;
+	output = name;
+
+	for (i = 0; i < 64; i++) {
+		events[i].type = EVENT_OUTPUT_CHANGE;
+		events[i].u.output.output = 0x42 + i;
+	}
+
+	output_init(-1, format, FLUSH_NONE);
+	output_set_names(1);
+	output_set_sources(NULL, 0);
+	output_burst(64, events, 64);
+	record = output_record(&len);
+	output = "DP-\"1\"";
+
+	if (len > OUTPUT_RECORD_MAX || len < strlen(begin) + strlen(end) ||
+	    memcmp(record, begin, strlen(begin)) ||
+	    memcmp(record + len - strlen(end), end, strlen(end))) {
+		fprintf(stderr, "FAIL: burst of %zu bytes ends with %.*s", len,
+			(int)(len < 32 ? len : 32), record + (len < 32 ? 0 : len - 32));
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const char *const displays[] = { ":0\"" };
+	struct event event;
+	int failed;
+
+	output_init(-1, FORMAT_JSON, FLUSH_NONE);
+	output_set_names(1);
+
+	memset(&event, 0, sizeof(event));
+	event.type = EVENT_OUTPUT_PROPERTY;
+	event.u.property.xid = 0x42;
+	event.u.property.atom = 0x100;
+	event.u.property.timestamp = 1234;
+	event.u.property.state = PropertyNewValue;
+
+	failed = expect(&event, "{\"event\":\"output_property\",\"output\":66,\"property\":256,"
+			"\"state\":\"new\",\"timestamp\":1234,\"name\":\"DP-\\\"1\\\"\","
+			"\"property_name\":\"EDID\\\"\\\\\\u0009\"}\n");
+
+	output_set_sources(displays, 1);
+	failed += expect(&event, "{\"event\":\"output_property\",\"output\":66,\"property\":256,"
+			 "\"state\":\"new\",\"timestamp\":1234,\"name\":\"DP-\\\"1\\\"\","
+			 "\"property_name\":\"EDID\\\"\\\\\\u0009\","
+			 "\"display\":\":0\\\"\",\"screen\":0}\n");
+
+	/* Quotes are escaped in JSON, so fewer records fit than in text */
+	failed += expect_truncated_burst(FORMAT_JSON, "{\"event\":\"burst\",\"events\":64,",
+					 "\"mode_name\":\"1920x1080\"}],\"truncated\":50}\n");
+	failed += expect_truncated_burst(FORMAT_TEXT, "XRRBurst events=64 records=26 truncated=38\t",
+					 " mode_name=1920x1080\n");
+
+	output_free();
+
+	return failed ? 1 : 0;
+}
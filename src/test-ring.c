@@ -0,0 +1,59 @@
+/*
+ * test-ring.c - Tests for the event ring
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include "backend.h"
+#include "ring.h"
+
+static struct event_ring ring;
+
+int main(void)
+{
+	struct event event;
+	unsigned long dropped;
+	int i;
+
+	event_ring_init(&ring);
+
+	/* A burst larger than the ring keeps the newest events */
+	for (i = 0; i < EVENT_RING_SIZE + 88; i++) {
+		event_ring_put(&ring)->u.resource.timestamp = i;
+	}
+
+	if ((dropped = event_ring_dropped(&ring)) != 88) {
+		fprintf(stderr, "FAIL: expected 88 dropped events, got %lu\n", dropped);
+		return 1;
+	}
+
+	for (i = 88; event_ring_get(&ring, &event); i++) {
+		if (event.u.resource.timestamp != i) {
+			fprintf(stderr, "FAIL: expected event %d, got %lu\n", i,
+				(unsigned long)event.u.resource.timestamp);
+			return 1;
+		}
+	}
+
+	if (i != EVENT_RING_SIZE + 88 || event_ring_dropped(&ring) != 0) {
+		fprintf(stderr, "FAIL: ring returned %d events\n", i - 88);
+		return 1;
+	}
+
+	return 0;
+}
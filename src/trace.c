@@ -0,0 +1,368 @@
+/*
+ * trace.c - Recording and replaying traces of events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "backend.h"
+#include "output.h"
+#include "trace.h"
+
+/* The file is extended in steps of this size, a multiple of the page size */
+#define TRACE_CHUNK_SIZE (1 << 20)
+#define TRACE_ENTRY_MAX (sizeof(struct trace_entry) + 64)
+
+/*
+ * Entries are appended to a shared mapping of the file, so that recording
+ * an event doesn't cost a system call. The file is truncated to the used
+ * length when the trace is closed. If xrandrwait doesn't get to do that,
+ * the trace ends with zeros, which replays treat as the end of the trace.
+ */
+static struct {
+	int fd;
+	char *data;
+	size_t size;
+	size_t len;
+	long long batch;
+} recorder = {
+	.fd = -1
+};
+
+static struct {
+	const char *data;
+	size_t size;
+	size_t pos;
+	const char *displays[MAX_DISPLAYS];
+	double speed;
+	long long batch;
+	int in_batch;
+	int done;
+} replay;
+
+static long long monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Extend the file and its mapping by one chunk */
+static int recorder_grow(void)
+{
+	size_t size = recorder.size + TRACE_CHUNK_SIZE;
+	void *data;
+	int err;
+
+	/* Allocate the blocks now, rather than getting SIGBUS later */
+	if ((err = posix_fallocate(recorder.fd, 0, size)) != 0) {
+		return -err;
+	}
+
+	if (recorder.data) {
+		munmap(recorder.data, recorder.size);
+		recorder.data = NULL;
+	}
+
+	if ((data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 recorder.fd, 0)) == MAP_FAILED) {
+		return -errno;
+	}
+
+	recorder.data = data;
+	recorder.size = size;
+
+	return 0;
+}
+
+int trace_record_open(const char *path, const char *const *displays, int ndisplays)
+{
+	struct trace_header header;
+	int err;
+	int i;
+
+	if (ndisplays < 0 || ndisplays > MAX_DISPLAYS) {
+		return -EINVAL;
+	}
+
+	/* Shared writable mappings need a descriptor that is open for reading */
+	if ((recorder.fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+		return -errno;
+	}
+
+	if ((err = recorder_grow()) < 0) {
+		trace_record_close();
+		return err;
+	}
+
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.ndisplays = ndisplays;
+
+	memcpy(recorder.data, &header, sizeof(header));
+	recorder.len = sizeof(header);
+
+	for (i = 0; i < ndisplays; i++) {
+		size_t len = strlen(displays[i]) + 1;
+
+		if (recorder.len + len > recorder.size) {
+			trace_record_close();
+			return -ENAMETOOLONG;
+		}
+
+		memcpy(recorder.data + recorder.len, displays[i], len);
+		recorder.len += len;
+	}
+
+	recorder.batch = monotonic_us();
+
+	return 0;
+}
+
+void trace_record_close(void)
+{
+	if (recorder.fd < 0) {
+		return;
+	}
+
+	if (recorder.data) {
+		munmap(recorder.data, recorder.size);
+		recorder.data = NULL;
+	}
+
+	if (ftruncate(recorder.fd, recorder.len) < 0) {
+		DBG(fprintf(stderr, "Could not truncate trace: %s\n", strerror(errno)));
+	}
+
+	close(recorder.fd);
+	recorder.fd = -1;
+	recorder.size = 0;
+	recorder.len = 0;
+}
+
+void trace_record(const struct event *event, int batch)
+{
+	struct trace_entry entry;
+	size_t len;
+
+	if (!recorder.data) {
+		return;
+	}
+
+	/* If the file can't be extended, keep what has been recorded so far */
+	if (recorder.size - recorder.len < TRACE_ENTRY_MAX && recorder_grow() < 0) {
+		DBG(fprintf(stderr, "Could not extend trace. Stopping to record.\n"));
+		trace_record_close();
+		return;
+	}
+
+	if (!(len = output_encode(event, recorder.data + recorder.len + sizeof(entry),
+				  recorder.size - recorder.len - sizeof(entry)))) {
+		return;
+	}
+
+	entry.delay = 0;
+
+	if (batch) {
+		long long now = monotonic_us();
+		long long delay = now - recorder.batch;
+
+		/* A delay of zero would merge the batch with the previous one */
+		entry.delay = delay < 1 ? 1 : delay > UINT32_MAX ? UINT32_MAX : delay;
+		recorder.batch = now;
+	}
+
+	memcpy(recorder.data + recorder.len, &entry, sizeof(entry));
+	recorder.len += sizeof(entry) + len;
+}
+
+int trace_replay_open(const char *path, double speed, const char *const **displays)
+{
+	struct trace_header header;
+	struct stat st;
+	void *data;
+	size_t pos;
+	int err;
+	int fd;
+	int i;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -errno;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+
+	if (st.st_size < sizeof(header)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err = data == MAP_FAILED ? -errno : 0;
+	close(fd);
+
+	if (err < 0) {
+		return err;
+	}
+
+	memset(&replay, 0, sizeof(replay));
+	replay.data = data;
+	replay.size = st.st_size;
+	replay.speed = speed;
+	replay.batch = monotonic_us();
+
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != TRACE_VERSION || header.ndisplays > MAX_DISPLAYS) {
+		trace_replay_close();
+		return -EINVAL;
+	}
+
+	for (pos = sizeof(header), i = 0; i < header.ndisplays; i++) {
+		const char *end = memchr(replay.data + pos, 0, replay.size - pos);
+
+		if (!end) {
+			trace_replay_close();
+			return -EINVAL;
+		}
+
+		replay.displays[i] = replay.data + pos;
+		pos = end - replay.data + 1;
+	}
+
+	replay.pos = pos;
+	*displays = replay.displays;
+
+	return header.ndisplays;
+}
+
+void trace_replay_close(void)
+{
+	if (replay.data) {
+		munmap((void*)replay.data, replay.size);
+		replay.data = NULL;
+	}
+}
+
+/*
+ * Read the delay of the next entry. Returns 1 if there is one, or 0 at the
+ * end of the trace, including the zeros left behind by an interrupted
+ * recording.
+ */
+static int peek_entry(struct trace_entry *entry)
+{
+	struct record_header header;
+
+	if (replay.size - replay.pos < sizeof(*entry) + sizeof(header)) {
+		return 0;
+	}
+
+	memcpy(entry, replay.data + replay.pos, sizeof(*entry));
+	memcpy(&header, replay.data + replay.pos + sizeof(*entry), sizeof(header));
+
+	return header.length != 0;
+}
+
+/* Time at which the batch starting with entry is due, in microseconds */
+static long long batch_due(const struct trace_entry *entry)
+{
+	return replay.batch + (long long)(entry->delay / replay.speed);
+}
+
+int trace_replay_next(struct event *event)
+{
+	struct trace_entry entry;
+	int len;
+
+	if (!peek_entry(&entry)) {
+		replay.done = 1;
+		replay.in_batch = 0;
+		return 0;
+	}
+
+	if (entry.delay) {
+		if (replay.in_batch) {
+			replay.in_batch = 0;
+			return 0;
+		}
+
+		if (replay.speed > 0) {
+			long long due = batch_due(&entry);
+
+			if (due > monotonic_us()) {
+				return 0;
+			}
+
+			/* Don't let the time spent handling events add up */
+			replay.batch = due;
+		}
+	}
+
+	len = output_decode(replay.data + replay.pos + sizeof(entry),
+			    replay.size - replay.pos - sizeof(entry), event);
+
+	if (len <= 0) {
+		return len < 0 ? len : -EINVAL;
+	}
+
+	replay.pos += sizeof(entry) + len;
+	replay.in_batch = 1;
+
+	return 1;
+}
+
+int trace_replay_wait(void)
+{
+	struct trace_entry entry;
+	long long wait;
+
+	if (replay.done || replay.speed <= 0 || !peek_entry(&entry)) {
+		return 0;
+	}
+
+	wait = batch_due(&entry) - monotonic_us();
+
+	if (wait <= 0) {
+		return 0;
+	}
+
+	wait = (wait + 999) / 1000;
+
+	return wait > INT_MAX ? INT_MAX : wait;
+}
+
+int trace_replay_done(void)
+{
+	return replay.done;
+}
@@ -0,0 +1,87 @@
+/*
+ * trace.h - Recording and replaying traces of events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "backend.h"
+
+#define TRACE_MAGIC "XRWT"
+#define TRACE_VERSION 1
+
+/*
+ * A trace starts with this header, followed by the names of the ndisplays
+ * displays that the events were received from, each terminated by a null
+ * byte. The rest of the file is a sequence of entries.
+ */
+struct trace_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t ndisplays;
+};
+
+/*
+ * Each entry is followed by the binary record of an event. delay is the
+ * time in microseconds between the first events of this and the previous
+ * batch, or 0 if the event was received in the same batch as the previous
+ * one.
+ */
+struct trace_entry {
+	uint32_t delay;
+};
+
+/*
+ * Create the trace file at path, replacing any existing file. Returns 0
+ * on success, or a negative error number.
+ */
+int trace_record_open(const char *path, const char *const *displays, int ndisplays);
+void trace_record_close(void);
+
+/*
+ * Append an event. batch is 1 for the first event of a batch. If the file
+ * can't be extended, recording stops.
+ */
+void trace_record(const struct event *event, int batch);
+
+/*
+ * Open a trace for replaying at speed times the speed at which it was
+ * recorded, or as fast as possible if speed is 0. The names of the
+ * displays are stored in *displays, and remain valid until the trace is
+ * closed. Returns the number of displays, or a negative error number.
+ */
+int trace_replay_open(const char *path, double speed, const char *const **displays);
+void trace_replay_close(void);
+
+/*
+ * Retrieve the next event, in the same batches in which they were
+ * recorded. Returns 1 if an event was stored in *event, 0 at the end of a
+ * batch or if the next batch isn't due yet, or a negative error number if
+ * the trace is corrupt.
+ */
+int trace_replay_next(struct event *event);
+
+/* Milliseconds until the next batch is due, 0 if it is due already */
+int trace_replay_wait(void);
+
+/* Returns 1 once all events of the trace have been retrieved */
+int trace_replay_done(void);
+
+#endif /* TRACE_H */
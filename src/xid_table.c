@@ -0,0 +1,147 @@
+/*
+ * xid_table.c - Hash tables keyed by XID
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "xid_table.h"
+
+#define XID_TABLE_INITIAL_SIZE 16
+
+#define ENTRY(table, i) ((table)->entries + (i) * (table)->entry_size)
+#define ENTRY_XID(entry) (*(uint32_t*)(entry))
+
+static size_t hash_xid(uint32_t xid)
+{
+	return xid * 2654435761u;
+}
+
+static int table_alloc(struct xid_table *table, size_t entry_size, size_t size)
+{
+	if (!(table->entries = calloc(size, entry_size))) {
+		return -ENOMEM;
+	}
+
+	table->entry_size = entry_size;
+	table->size = size;
+	table->used = 0;
+
+	return 0;
+}
+
+int xid_table_init(struct xid_table *table, size_t entry_size)
+{
+	return table_alloc(table, entry_size, XID_TABLE_INITIAL_SIZE);
+}
+
+void xid_table_free(struct xid_table *table)
+{
+	free(table->entries);
+	memset(table, 0, sizeof(*table));
+}
+
+void xid_table_clear(struct xid_table *table)
+{
+	if (table->entries) {
+		memset(table->entries, 0, table->size * table->entry_size);
+	}
+
+	table->used = 0;
+}
+
+static char *table_slot(struct xid_table *table, uint32_t xid)
+{
+	size_t mask = table->size - 1;
+	size_t i;
+
+	for (i = hash_xid(xid) & mask;
+	     ENTRY_XID(ENTRY(table, i)) && ENTRY_XID(ENTRY(table, i)) != xid;
+	     i = (i + 1) & mask);
+
+	return ENTRY(table, i);
+}
+
+static int table_grow(struct xid_table *table)
+{
+	struct xid_table grown;
+	size_t i;
+	int err;
+
+	if ((err = table_alloc(&grown, table->entry_size, table->size * 2)) < 0) {
+		return err;
+	}
+
+	for (i = 0; i < table->size; i++) {
+		char *entry = ENTRY(table, i);
+
+		if (ENTRY_XID(entry)) {
+			memcpy(table_slot(&grown, ENTRY_XID(entry)), entry,
+			       table->entry_size);
+			grown.used++;
+		}
+	}
+
+	free(table->entries);
+	*table = grown;
+
+	return 0;
+}
+
+void *xid_table_find(struct xid_table *table, uint32_t xid)
+{
+	char *entry;
+
+	if (!xid || !table->entries) {
+		return NULL;
+	}
+
+	entry = table_slot(table, xid);
+
+	return ENTRY_XID(entry) ? entry : NULL;
+}
+
+void *xid_table_get(struct xid_table *table, uint32_t xid)
+{
+	char *entry;
+
+	if (!xid || !table->entries) {
+		return NULL;
+	}
+
+	entry = table_slot(table, xid);
+
+	if (!ENTRY_XID(entry)) {
+		if ((table->used + 1) * 2 > table->size) {
+			if (table_grow(table) < 0) {
+				return NULL;
+			}
+
+			entry = table_slot(table, xid);
+		}
+
+		memset(entry, 0, table->entry_size);
+		ENTRY_XID(entry) = xid;
+		table->used++;
+	}
+
+	return entry;
+}
@@ -0,0 +1,56 @@
+/*
+ * xid_table.h - Hash tables keyed by XID
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XID_TABLE_H
+#define XID_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Open-addressing hash table of fixed-size entries. Every entry must start
+ * with a uint32_t holding its XID; an XID of 0 (None) marks a free slot.
+ * Entries are never removed, so users that need to forget an entry keep
+ * a flag of their own.
+ */
+struct xid_table {
+	char *entries;
+	size_t entry_size;
+	size_t size;
+	size_t used;
+};
+
+int xid_table_init(struct xid_table *table, size_t entry_size);
+void xid_table_free(struct xid_table *table);
+
+/* Remove all entries, keeping the memory allocated for them */
+void xid_table_clear(struct xid_table *table);
+
+/* Look up the entry for xid, or NULL if there is none */
+void *xid_table_find(struct xid_table *table, uint32_t xid);
+
+/*
+ * Look up the entry for xid, creating it if it doesn't exist yet. New
+ * entries are zeroed, except for the XID. Returns NULL if the entry could
+ * not be created, or if xid is 0.
+ */
+void *xid_table_get(struct xid_table *table, uint32_t xid);
+
+#endif /* XID_TABLE_H */
@@ -21,86 +21,142 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <getopt.h>
 #include <string.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <time.h>
-#include <X11/Xlib.h>
-#include <X11/extensions/Xrandr.h>
-
-#if DEBUG
-#define DBG(hoge) do { hoge; } while (0)
-#else
-#define DBG(hoge)
-#endif /* DEBUG */
+#include <sys/resource.h>
+#include "backend.h"
+#include "hook.h"
+#include "output.h"
+#include "state.h"
+#include "names.h"
+#include "monitor.h"
+#include "provider.h"
+#include "filter.h"
+#include "server.h"
+#include "client.h"
+#include "stats.h"
+#include "trace.h"
+#include "ready.h"
+#include "duration.h"
 
 #define DEFAULT_MASK (RRCrtcChangeNotifyMask   | \
                       RROutputChangeNotifyMask | \
                       RRScreenChangeNotifyMask)
 
-static const char *rotation_names[] = {
-	[0]             = "E",
-	[RR_Rotate_0]   = "0",
-	[RR_Rotate_90]  = "90",
-	[RR_Rotate_180] = "180",
-	[RR_Rotate_270] = "270"
-};
-
-static const char *reflection_names[] = {
-	[0]                           = "0",
-	[1]                           = "E",
-	[RR_Reflect_X]                = "X",
-	[RR_Reflect_Y]                = "Y",
-	[RR_Reflect_X | RR_Reflect_Y] = "XY"
-};
-
-static const char *connection_names[] = {
-	[RR_Connected]         = "Y",
-	[RR_Disconnected]      = "N",
-	[RR_UnknownConnection] = "?",
-	[3]                    = "E"
-};
-
-#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+#define BURST_SIZE 64
+#define RECONNECT_MIN_MS 100
+#define RECONNECT_MAX_MS 10000
+#define MAX_VARS 16
+#define VAR_SIZE 96
 
-struct context {
-	Display *display;
-	int screen;
-	Window root;
-	int event_base;
-	int error_base;
+/*
+ * Events that can be selected with --event, indexed by event type. Events
+ * with a mask are passed on to the rest of the pipeline; everything else
+ * the backend couldn't decode is dropped.
+ */
+static const struct {
+	const char *name;
+	int mask;
+} event_map[EVENT_TYPES] = {
+	[EVENT_SCREEN_CHANGE]     = { "screen_change",     RRScreenChangeNotifyMask },
+	[EVENT_CRTC_CHANGE]       = { "crtc_change",       RRCrtcChangeNotifyMask },
+	[EVENT_OUTPUT_CHANGE]     = { "output_change",     RROutputChangeNotifyMask },
+	[EVENT_OUTPUT_PROPERTY]   = { "output_property",   RROutputPropertyNotifyMask },
+	[EVENT_PROVIDER_CHANGE]   = { "provider_change",   RRProviderChangeNotifyMask },
+	[EVENT_PROVIDER_PROPERTY] = { "provider_property", RRProviderPropertyNotifyMask },
+	[EVENT_RESOURCE_CHANGE]   = { "resource_change",   RRResourceChangeNotifyMask },
+	[EVENT_LEASE]             = { "lease",             RRLeaseNotifyMask }
 };
 
-static int running = 0;
+static volatile sig_atomic_t running = 0;
+static volatile sig_atomic_t dump_stats = 0;
 static int monitor = 0;
 static int quiet = 0;
-static unsigned int timeout = 0;
+static long timeout = 0;
+static long until_stable = 0;
 static int events = 0;
+static int signal_pipe[2] = { -1, -1 };
+static long debounce = 0;
+static const char *exec_cmds[HOOK_MAX_COMMANDS];
+static int nexec = 0;
+static int exec_persistent = 0;
+static int exec_jobs = 1;
+static enum output_format format = FORMAT_TEXT;
+static enum flush_policy flush_policy = FLUSH_BATCH;
+static enum backpressure backpressure = BACKPRESSURE_BLOCK;
+static int changes_only = 0;
+static int initial = 0;
+static int reconnect = 0;
+static int event_mask = 0;
+static int resolve_names = 0;
+static int identify_monitors = 0;
+static int report_providers = 0;
+static const char *displays[MAX_DISPLAYS];
+static int ndisplays = 0;
+static int tag_sources = 0;
+static const char *serve_path = NULL;
+static const char *connect_path = NULL;
+static const char *record_path = NULL;
+static const char *replay_path = NULL;
+static double replay_speed = 0;
+static int collect_stats = 0;
+static const char *stats_path = NULL;
+static int time_startup = 0;
+static int ready_fd = -1;
+static char *notify_socket = NULL;
 
-static const char *rotation_name(const unsigned long rot)
-{
-	unsigned long rotation = rot & 0xf;
+/*
+ * In client and replay mode, there is a single NULL context for the
+ * server or the trace.
+ */
+static struct context *contexts[MAX_DISPLAYS];
+static int ncontexts = 0;
 
-	return rotation_names[rotation >= ARRAY_SIZE(rotation_names) ? 0 : rotation];
-}
+/*
+ * Displays whose connection was lost have a NULL context, and the time at
+ * which the next attempt to reconnect is due.
+ */
+static struct {
+	long long at;
+	long delay;
+} reconnects[MAX_DISPLAYS];
+
+/*
+ * Events received during the current debounce window. Only the most
+ * recent event for each CRTC, output, or screen is kept.
+ */
+static struct {
+	struct event events[BURST_SIZE];
+	int len;
+	int received;
+	long long deadline;
+} burst;
 
-static const char *reflection_name(const unsigned long ref)
+static long long monotonic_ms(void)
 {
-	unsigned long reflection = ref & 0xf0;
+	struct timespec ts;
 
-	if (reflection & ~(RR_Reflect_X | RR_Reflect_Y)) {
-		reflection = 1;
-	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	return reflection_names[reflection];
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-static const char *connection_name(const unsigned long conn)
+static long long monotonic_us(void)
 {
-	return connection_names[conn >= ARRAY_SIZE(connection_names) ? 3 : conn];
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 static void print_usage(const char *cmdname)
@@ -109,78 +165,314 @@ static void print_usage(const char *cmdname)
 	       "Wait for a particular XRandR event\n"
 	       "\n"
 	       "Options:\n"
+	       "  -b  --on-backpressure\n"
+	       "                 What to do with records if the reader of the output falls\n"
+	       "                 behind. Allowed values: block (the default), drop, coalesce\n"
+	       "  -c  --connect  Receive events from the xrandrwait server listening on the\n"
+	       "                 specified socket instead of connecting to the X server\n"
+	       "  -C  --changes-only\n"
+	       "                 Only report events that change the configuration of a\n"
+	       "                 CRTC, output, or the screen\n"
+	       "  -D  --display  Watch the specified display instead of $DISPLAY. This\n"
+	       "                 option may be specified more than once.\n"
+	       "  -d  --debounce Collect events until none has occurred for the specified\n"
+	       "                 time (in milliseconds, unless a unit is given), then\n"
+	       "                 report them on a single line\n"
 	       "  -e  --event    Listen for specific events. If omitted, all events are\n"
 	       "                 listened for. This option may be specified more than once.\n"
-	       "                 Allowed values: crtc_change, output_change, screen_change\n"
+	       "                 Allowed values: crtc_change, output_change, screen_change,\n"
+	       "                 output_property, provider_change, provider_property,\n"
+	       "                 resource_change, lease\n"
+	       "  -f  --format   Output format of the records. Allowed values: text (the\n"
+	       "                 default), json, binary\n"
+	       "  -F  --flush    When to write records. Allowed values: batch (once all\n"
+	       "                 pending events have been handled, the default), line\n"
+	       "                 (after each record), none (when the buffer is full)\n"
+	       "  -g  --providers\n"
+	       "                 Report provider and resource changes, with the names and\n"
+	       "                 capabilities of providers\n"
 	       "  -h  --help     Print this text\n"
+	       "  -i  --initial  Report the current configuration of all CRTCs and outputs\n"
+	       "                 before waiting for events\n"
+	       "  -I  --identify Report the monitors connected to outputs, as identified by\n"
+	       "                 their EDID\n"
+	       "  -j  --jobs     Run up to the specified number of commands given with\n"
+	       "                 --exec at the same time (1 by default)\n"
+	       "  -k  --reconnect\n"
+	       "                 Reconnect to a display if the connection to it is lost,\n"
+	       "                 instead of exiting\n"
 	       "  -m  --monitor  Do not exit after an event occurs\n"
+	       "  -M  --match    Only handle events that match a filter of the form\n"
+	       "                 field=value[,field=value...]. This option may be\n"
+	       "                 specified more than once.\n"
+	       "  -n  --names    Report the names of outputs and modes\n"
+	       "  -p  --persistent\n"
+	       "                 Start the command given with --exec only once and write\n"
+	       "                 the records to its standard input\n"
+	       "  -P  --speed    Replay the trace given with --replay at the specified\n"
+	       "                 multiple of the speed at which it was recorded, such as\n"
+	       "                 1 for the original speed\n"
 	       "  -q  --quiet    Do not print any output\n"
-	       "  -t  --timeout  Exit if no event has occurred within the specified number\n"
-	       "                 of seconds\n",
+	       "  -r  --record   Write all events that are received to the specified trace\n"
+	       "                 file\n"
+	       "  -R  --replay   Read events from the specified trace file instead of\n"
+	       "                 connecting to the X server\n"
+	       "  -s  --stats    Collect statistics about events and latencies and write\n"
+	       "                 them to standard error, or to the file given as in\n"
+	       "                 --stats=FILE, on exit and on SIGUSR2\n"
+	       "  -S  --serve    Broadcast all events to clients connecting to the specified\n"
+	       "                 socket. Implies --monitor\n"
+	       "  -t  --timeout  Exit if no event has occurred within the specified time,\n"
+	       "                 given in seconds or with a unit, as in 10s or 250ms\n"
+	       "  -T  --time-startup\n"
+	       "                 Write the time it took to start waiting for events to\n"
+	       "                 standard error\n"
+	       "  -u  --until-stable\n"
+	       "                 Exit once no event has occurred for the specified time\n"
+	       "                 (in milliseconds, unless a unit is given)\n"
+	       "  -x  --exec     Execute a command for each event. The event is described\n"
+	       "                 in XRANDRWAIT_* environment variables. This option may be\n"
+	       "                 specified more than once.\n"
+	       "  -y  --ready-fd Write a newline to the specified file descriptor and close\n"
+	       "                 it once events are being waited for\n",
 	       cmdname);
 }
 
 static int parse_cmdline(int argc, char *argv[])
 {
-	static const char *shortopts = "e:hmqt:";
+	static const char *shortopts = "b:c:Cd:D:e:f:F:ghiIj:kmM:npP:qr:R:s::S:t:Tu:x:y:";
 	static const struct option cmd_opts[] = {
+		{ "on-backpressure", required_argument, 0, 'b' },
+		{ "connect", required_argument, 0, 'c' },
+		{ "changes-only", no_argument,  0, 'C' },
+		{ "debounce", required_argument, 0, 'd' },
+		{ "display", required_argument, 0, 'D' },
 	        { "event",   required_argument, 0, 'e' },
+		{ "format",  required_argument, 0, 'f' },
+		{ "flush",   required_argument, 0, 'F' },
+		{ "providers", no_argument,     0, 'g' },
 		{ "help",    no_argument,       0, 'h' },
+		{ "initial", no_argument,       0, 'i' },
+		{ "identify", no_argument,      0, 'I' },
+		{ "jobs",    required_argument, 0, 'j' },
+		{ "reconnect", no_argument,     0, 'k' },
 		{ "monitor", no_argument,       0, 'm' },
+		{ "match",   required_argument, 0, 'M' },
+		{ "names",   no_argument,       0, 'n' },
+		{ "persistent", no_argument,    0, 'p' },
+		{ "speed",   required_argument, 0, 'P' },
 		{ "quiet",   no_argument,       0, 'q' },
+		{ "record",  required_argument, 0, 'r' },
+		{ "replay",  required_argument, 0, 'R' },
+		{ "serve",   required_argument, 0, 'S' },
+		{ "stats",   optional_argument, 0, 's' },
 		{ "timeout", required_argument, 0, 't' },
+		{ "time-startup", no_argument,  0, 'T' },
+		{ "until-stable", required_argument, 0, 'u' },
+		{ "exec",    required_argument, 0, 'x' },
+		{ "ready-fd", required_argument, 0, 'y' },
 		{ NULL }
 	};
 
-	static struct {
-		const char *name;
-		int mask;
-	} event_map[] = {
-		{
-			.name = "crtc_change",
-			.mask = RRCrtcChangeNotifyMask
-		}, {
-			.name = "output_change",
-			.mask = RROutputChangeNotifyMask
-		}, {
-			.name = "screen_change",
-			.mask = RRScreenChangeNotifyMask
-		}
-	};
-
+	char *end;
+	long value;
 	int opt;
+	int err;
 	int i;
 
 	do {
 		opt = getopt_long(argc, argv, shortopts, cmd_opts, NULL);
 
 		switch (opt) {
+		case 'b':
+			if (output_parse_backpressure(optarg, &backpressure) < 0) {
+				fprintf(stderr, "Invalid backpressure policy: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'c':
+			connect_path = optarg;
+			break;
+
+		case 'C':
+			changes_only = 1;
+			break;
+
+		case 'd':
+			if ((err = duration_parse(optarg, 1, &debounce)) < 0) {
+				fprintf(stderr, "Invalid debounce interval: %s (%s)\n",
+					optarg, strerror(-err));
+				return 1;
+			}
+
+			break;
+
+		case 'D':
+			if (ndisplays == ARRAY_SIZE(displays)) {
+				fprintf(stderr, "Too many displays (at most %d)\n",
+					(int)ARRAY_SIZE(displays));
+				return 1;
+			}
+
+			displays[ndisplays++] = optarg;
+			break;
+
 		case 'e':
 			for (i = 0; i < ARRAY_SIZE(event_map); i++) {
-				if (strcmp(optarg, event_map[i].name) == 0) {
+				if (event_map[i].name && strcmp(optarg, event_map[i].name) == 0) {
 					events |= event_map[i].mask;
 					break;
 				}
 			}
 			break;
 
+		case 'f':
+			if (output_parse_format(optarg, &format) < 0) {
+				fprintf(stderr, "Invalid format: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'F':
+			if (output_parse_flush_policy(optarg, &flush_policy) < 0) {
+				fprintf(stderr, "Invalid flush policy: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'g':
+			report_providers = 1;
+			break;
+
+		case 'i':
+			initial = 1;
+			break;
+
+		case 'I':
+			identify_monitors = 1;
+			break;
+
+		case 'j':
+			errno = 0;
+			value = strtol(optarg, &end, 10);
+
+			if (errno || end == optarg || *end || value < 1 || value > HOOK_MAX_JOBS) {
+				fprintf(stderr, "Invalid number of jobs: %s (at most %d)\n",
+					optarg, HOOK_MAX_JOBS);
+				return 1;
+			}
+
+			exec_jobs = value;
+			break;
+
+		case 'k':
+			reconnect = 1;
+			break;
+
 		case 'm':
 			monitor = 1;
 			break;
 
+		case 'M':
+			if ((err = filter_add(optarg)) < 0) {
+				fprintf(stderr, "Invalid filter: %s (%s)\n",
+					optarg, strerror(-err));
+				return 1;
+			}
+
+			break;
+
+		case 'n':
+			resolve_names = 1;
+			break;
+
+		case 'p':
+			exec_persistent = 1;
+			break;
+
+		case 'P':
+			errno = 0;
+			replay_speed = strtod(optarg, &end);
+
+			if (errno || end == optarg || *end || replay_speed < 0) {
+				fprintf(stderr, "Invalid speed: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
 		case 'q':
 			quiet = 1;
 			break;
 
-		case 't':
+		case 'r':
+			record_path = optarg;
+			break;
+
+		case 'R':
+			replay_path = optarg;
+			break;
+
+		case 's':
+			collect_stats = 1;
+			stats_path = optarg;
+			break;
+
+		case 'S':
+			serve_path = optarg;
+			monitor = 1;
+			break;
+
+		case 'x':
+			if (nexec == ARRAY_SIZE(exec_cmds)) {
+				fprintf(stderr, "Too many commands (at most %d)\n",
+					(int)ARRAY_SIZE(exec_cmds));
+				return 1;
+			}
+
+			exec_cmds[nexec++] = optarg;
+			break;
+
+		case 'y':
 			errno = 0;
-			timeout = strtol(optarg, NULL, 10);
-			if (errno) {
+			value = strtol(optarg, &end, 10);
+
+			/* Commands started for events must not hold it open */
+			if (errno || end == optarg || *end || value < 0 || value > INT_MAX ||
+			    fcntl(value, F_SETFD, FD_CLOEXEC) < 0) {
+				fprintf(stderr, "Invalid file descriptor: %s\n", optarg);
+				return 1;
+			}
+
+			ready_fd = value;
+			break;
+
+		case 't':
+			if ((err = duration_parse(optarg, 1000, &timeout)) < 0) {
 				fprintf(stderr, "Invalid timeout: %s (%s)\n",
-					optarg, strerror(errno));
+					optarg, strerror(-err));
+				return 1;
+			}
+
+			break;
+
+		case 'T':
+			time_startup = 1;
+			break;
+
+		case 'u':
+			if ((err = duration_parse(optarg, 1, &until_stable)) < 0 || !until_stable) {
+				fprintf(stderr, "Invalid settle time: %s (%s)\n",
+					optarg, strerror(err < 0 ? -err : EINVAL));
 				return 1;
 			}
 
+			/* Events don't end the wait, only the lack of them does */
+			monitor = 1;
 			break;
 
 		case 'h':
@@ -193,12 +485,45 @@ static int parse_cmdline(int argc, char *argv[])
 		}
 	} while (opt != -1);
 
+	if (connect_path && replay_path) {
+		fprintf(stderr, "--connect can't be used with --replay\n");
+		return 1;
+	}
+
+	/* Clients and replays never talk to the X server, so they can't resolve names */
+	if ((connect_path || replay_path) &&
+	    (ndisplays || resolve_names || initial || identify_monitors ||
+	     report_providers || filter_needs_names())) {
+		fprintf(stderr, "--%s can't be used with --display, --names, "
+			"--initial, --identify, --providers, or filters on names\n",
+			connect_path ? "connect" : "replay");
+		return 1;
+	}
+
+	/* On top of whatever else was asked for */
+	if (report_providers) {
+		events |= (events ? 0 : DEFAULT_MASK) |
+			  RRProviderChangeNotifyMask | RRResourceChangeNotifyMask;
+	}
+
 	return 0;
 }
 
 static void handle_signal(int sig)
 {
+	int saved_errno;
+
+	saved_errno = errno;
+
 	switch (sig) {
+	case SIGUSR2:
+		dump_stats = 1;
+		break;
+
+	case SIGCHLD:
+		/* A command has exited and the main loop has to collect it */
+		break;
+
 	case SIGINT:
 	case SIGHUP:
 	case SIGTERM:
@@ -209,9 +534,39 @@ static void handle_signal(int sig)
 		running = 0;
 		break;
 	}
+
+	/* Wake up the main loop if it is blocked in poll() */
+	if (write(signal_pipe[1], &sig, 1) < 0) {
+		/* Pipe is full, so the main loop will wake up anyway */
+	}
+
+	errno = saved_errno;
+}
+
+static int make_pipe(int fds[2])
+{
+	int i;
+
+	if (pipe(fds) < 0) {
+		return -errno;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK) < 0 ||
+		    fcntl(fds[i], F_SETFD, FD_CLOEXEC) < 0) {
+			int err = -errno;
+
+			close(fds[0]);
+			close(fds[1]);
+			fds[0] = fds[1] = -1;
+			return err;
+		}
+	}
+
+	return 0;
 }
 
-static void setup_signals(void)
+static int setup_signals(void)
 {
 	static const int signals[] = {
 		SIGINT,
@@ -222,6 +577,11 @@ static void setup_signals(void)
 	};
 	struct sigaction action;
 	unsigned int i;
+	int err;
+
+	if ((err = make_pipe(signal_pipe)) < 0) {
+		return err;
+	}
 
 	memset(&action, 0, sizeof(action));
 	action.sa_handler = handle_signal;
@@ -229,179 +589,1049 @@ static void setup_signals(void)
 	for (i = 0; i < (sizeof(signals) / sizeof(signals[0])); i++) {
 		sigaction(signals[i], &action, NULL);
 	}
-}
 
-static int context_init_xrr(struct context *ctx)
-{
-	int event_mask;
-	
-	if (!XRRQueryExtension(ctx->display,
-			       &ctx->event_base,
-			       &ctx->error_base)) {
-		return -ENOTSUP;
+	/* Without --stats, SIGUSR2 keeps its default action */
+	if (collect_stats) {
+		sigaction(SIGUSR2, &action, NULL);
 	}
 
-	if (events) {
-		event_mask = events;
-	} else {
-		event_mask = DEFAULT_MASK;
+	/* Commands run in the background unless they are fed records */
+	if (nexec && !exec_persistent) {
+		action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+		sigaction(SIGCHLD, &action, NULL);
 	}
 
-	XRRSelectInput(ctx->display, ctx->root, event_mask);
-	
 	return 0;
 }
 
-static int context_close(struct context *ctx)
+/*
+ * Describe an event in the form of environment variables for the hook.
+ * Returns the number of variables that were stored in vars.
+ */
+static int event_vars(const struct event *event, char vars[][VAR_SIZE])
 {
-	if (!ctx) {
-		return -EINVAL;
+	int n = 0;
+
+#define VAR(name, fmt, val) snprintf(vars[n++], VAR_SIZE, "XRANDRWAIT_" name "=" fmt, val)
+	/* Events from clients and replays carry whatever display they claim */
+	if (tag_sources) {
+		VAR("DISPLAY", "%s", event->display < ndisplays && displays[event->display] ?
+				     displays[event->display] : "");
+		VAR("SCREEN", "%d", event->screen);
 	}
-	
-	if (!ctx->display) {
-		return -EALREADY;
+
+	switch (event->type) {
+	case EVENT_SCREEN_CHANGE:
+		VAR("EVENT", "%s", "screen_change");
+		VAR("WIDTH", "%d", event->u.screen.width);
+		VAR("HEIGHT", "%d", event->u.screen.height);
+		VAR("MM_WIDTH", "%d", event->u.screen.mwidth);
+		VAR("MM_HEIGHT", "%d", event->u.screen.mheight);
+		VAR("ROTATION", "%s", rotation_name(event->u.screen.rotation));
+		VAR("REFLECTION", "%s", reflection_name(event->u.screen.rotation));
+		VAR("TIMESTAMP", "%lu", (unsigned long)event->u.screen.timestamp);
+		VAR("CONFIG_TIMESTAMP", "%lu", (unsigned long)event->u.screen.config_timestamp);
+		break;
+
+	case EVENT_OUTPUT_CHANGE:
+		VAR("EVENT", "%s", "output_change");
+		VAR("OUTPUT", "0x%lx", (unsigned long)event->u.output.output);
+		VAR("CRTC", "0x%lx", (unsigned long)event->u.output.crtc);
+		VAR("MODE", "0x%lx", (unsigned long)event->u.output.mode);
+		VAR("CONNECTION", "%s", connection_name(event->u.output.connection));
+
+		if (resolve_names) {
+			VAR("NAME", "%s", names_output(event->display, event->u.output.output));
+			VAR("MODE_NAME", "%s", names_mode(event->display, event->u.output.mode));
+		}
+
+		if (identify_monitors) {
+			const struct monitor_info *info;
+
+			info = monitor_lookup(event->display, event->u.output.output);
+			VAR("MONITOR_ID", "%s", info ? info->id : "none");
+			VAR("VENDOR", "%s", info ? info->vendor : "none");
+			VAR("MODEL", "%s", info ? info->model : "none");
+			VAR("SERIAL", "%s", info ? info->serial : "none");
+		}
+		break;
+
+	case EVENT_CRTC_CHANGE:
+		VAR("EVENT", "%s", "crtc_change");
+		VAR("CRTC", "0x%lx", (unsigned long)event->u.crtc.crtc);
+		VAR("MODE", "0x%lx", (unsigned long)event->u.crtc.mode);
+		VAR("X", "%d", event->u.crtc.x);
+		VAR("Y", "%d", event->u.crtc.y);
+		VAR("WIDTH", "%d", event->u.crtc.width);
+		VAR("HEIGHT", "%d", event->u.crtc.height);
+		VAR("ROTATION", "%s", rotation_name(event->u.crtc.rotation));
+		VAR("REFLECTION", "%s", reflection_name(event->u.crtc.rotation));
+
+		if (resolve_names) {
+			VAR("MODE_NAME", "%s", names_mode(event->display, event->u.crtc.mode));
+		}
+		break;
+
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		VAR("EVENT", "%s", event_name(event->type));
+
+		if (event->type == EVENT_OUTPUT_PROPERTY) {
+			VAR("OUTPUT", "0x%lx", (unsigned long)event->u.property.xid);
+		} else {
+			VAR("PROVIDER", "0x%lx", (unsigned long)event->u.property.xid);
+		}
+
+		VAR("PROPERTY", "0x%lx", (unsigned long)event->u.property.atom);
+		VAR("STATE", "%s", property_state_name(event->u.property.state));
+		VAR("TIMESTAMP", "%lu", (unsigned long)event->u.property.timestamp);
+
+		if (resolve_names) {
+			if (event->type == EVENT_OUTPUT_PROPERTY) {
+				VAR("NAME", "%s", names_output(event->display, event->u.property.xid));
+			}
+
+			VAR("PROPERTY_NAME", "%s", names_atom(event->display, event->u.property.atom));
+		}
+		break;
+
+	case EVENT_PROVIDER_CHANGE:
+		VAR("EVENT", "%s", "provider_change");
+		VAR("PROVIDER", "0x%lx", (unsigned long)event->u.provider.provider);
+		VAR("TIMESTAMP", "%lu", (unsigned long)event->u.provider.timestamp);
+
+		if (report_providers) {
+			const struct provider_info *info;
+			char caps[PROVIDER_CAPABILITIES_SIZE];
+
+			info = provider_lookup(event->display, event->u.provider.provider);
+			VAR("PROVIDER_NAME", "%s", info && info->name[0] ? info->name : "none");
+			VAR("CAPABILITIES", "%s", info ? provider_capabilities(info->capabilities,
+									   caps, sizeof(caps)) : "none");
+			VAR("CRTCS", "%u", info ? info->ncrtcs : 0);
+			VAR("OUTPUTS", "%u", info ? info->noutputs : 0);
+		}
+		break;
+
+	case EVENT_RESOURCE_CHANGE:
+		VAR("EVENT", "%s", "resource_change");
+		VAR("TIMESTAMP", "%lu", (unsigned long)event->u.resource.timestamp);
+		break;
+
+	case EVENT_LEASE:
+		VAR("EVENT", "%s", "lease");
+		VAR("LEASE", "0x%lx", (unsigned long)event->u.lease.lease);
+		VAR("CREATED", "%s", event->u.lease.created ? "Y" : "N");
+		VAR("TIMESTAMP", "%lu", (unsigned long)event->u.lease.timestamp);
+		break;
+
+	default:
+		break;
 	}
-	
-	XCloseDisplay(ctx->display);
-	memset(ctx, 0, sizeof(*ctx));
+#undef VAR
 
-	return 0;
+	return n;
 }
 
-static int context_open(struct context *ctx)
+/*
+ * Pass the record that was just formatted to the hook. Text records are
+ * also passed in the environment, without the trailing newline.
+ */
+static void run_hook(const struct hook_key *key, char vars[][VAR_SIZE], int nvars)
 {
-	int err;
-
-	ctx->display = XOpenDisplay(NULL);
-	err = 0;
+	static char record_var[32 + OUTPUT_RECORD_MAX];
+	char *envp[MAX_VARS + 1];
+	const char *rec;
+	size_t len;
+	int i;
 
-	if (!ctx->display) {
-		DBG(fprintf(stderr, "Could not open display\n"));
-		return -EIO;
+	if (!nexec) {
+		return;
 	}
 
-	ctx->screen = DefaultScreen(ctx->display);
-	ctx->root = RootWindow(ctx->display, ctx->screen);
+	rec = output_record(&len);
 
-	if ((err = context_init_xrr(ctx)) < 0) {
-		DBG(fprintf(stderr, "Could not initialize XRandR extension\n"));
-		context_close(ctx);
+	for (i = 0; i < nvars; i++) {
+		envp[i] = vars[i];
 	}
-	
-	return err;
-}
 
-static int handle_output_change_event(struct context *ctx, XRROutputChangeNotifyEvent *event)
-{
-	if (!quiet) {
-		printf("XRROutputChangeNotifyEvent output=0x%lx crtc=0x%lx mode=0x%lx connection=%s\n",
-		       event->output, event->crtc, event->mode, connection_name(event->connection));
+	if (output_format() != FORMAT_BINARY) {
+		snprintf(record_var, sizeof(record_var), "XRANDRWAIT_RECORD=%.*s",
+			 (int)(len > 0 ? len - 1 : 0), rec);
+		envp[i++] = record_var;
 	}
 
-	return 0;
+	hook_run(key, rec, len, envp, i);
 }
 
-static int handle_crtc_change_event(struct context *ctx, XRRCrtcChangeNotifyEvent *event)
+static int events_match(const struct event *a, const struct event *b)
 {
-	if (!quiet) {
-		printf("XRRCrtcChangeNotifyEvent crtc=0x%lx res=%dx%d pos=%dx%d mode=0x%lx rotation=%s reflection=%s\n",
-		       event->crtc, event->width, event->height, event->x, event->y, event->mode,
-		       rotation_name(event->rotation), reflection_name(event->rotation));
+	if (a->type != b->type || a->display != b->display) {
+		return 0;
 	}
 
-	return 0;
+	switch (a->type) {
+	case EVENT_OUTPUT_CHANGE:
+		return a->u.output.output == b->u.output.output;
+
+	case EVENT_CRTC_CHANGE:
+		return a->u.crtc.crtc == b->u.crtc.crtc;
+
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		return a->u.property.xid == b->u.property.xid &&
+		       a->u.property.atom == b->u.property.atom;
+
+	case EVENT_PROVIDER_CHANGE:
+		return a->u.provider.provider == b->u.provider.provider;
+
+	case EVENT_LEASE:
+		return a->u.lease.lease == b->u.lease.lease;
+
+	default:
+		return a->screen == b->screen;
+	}
 }
 
-static int handle_events(struct context *ctx)
+/*
+ * The object that an event is about, so that the commands run for events
+ * about the same output are started in order. Commands for events that
+ * add_to_burst() would merge replace each other while they are queued.
+ */
+static void event_key(const struct event *event, struct hook_key *key)
 {
-	XEvent event;
-	int handled;
+	key->display = event->display;
+	key->kind = event->type;
+	key->detail = 0;
 
-	handled = 0;
+	switch (event->type) {
+	case EVENT_OUTPUT_CHANGE:
+		key->object = event->u.output.output;
+		break;
 
-	while (XEventsQueued(ctx->display, QueuedAfterFlush) > 0) {
-#if DEBUG
-		const char *event_type;
-#endif /* DEBUG */
+	case EVENT_CRTC_CHANGE:
+		key->object = event->u.crtc.crtc;
+		break;
 
-		if (XNextEvent(ctx->display, &event) != 0) {
-			continue;
-		}
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		key->object = event->u.property.xid;
+		key->detail = event->u.property.atom;
+		break;
 
-		switch(event.type - ctx->event_base) {
-		case RRScreenChangeNotify:
-			DBG(event_type = "RRScreenChangeNotify");
-			handled = 1;
-			break;
+	case EVENT_PROVIDER_CHANGE:
+		key->object = event->u.provider.provider;
+		break;
 
-		case RRNotify:
-			switch (((XRRNotifyEvent*)&event)->subtype) {
-			case RRNotify_OutputChange:
-				DBG(event_type = "RRNotify_OutputChange");
-				handle_output_change_event(ctx, (XRROutputChangeNotifyEvent*)&event);
-				handled = 1;
-				break;
-				
-			case RRNotify_CrtcChange:
-				DBG(event_type = "RRNotify_CrtcChange");
-				handle_crtc_change_event(ctx, (XRRCrtcChangeNotifyEvent*)&event);
-				handled = 1;
-				break;
+	case EVENT_LEASE:
+		key->object = event->u.lease.lease;
+		break;
 
-			default:
-				DBG(event_type = "(other XRandR event)");
-				break;
-			}
-			break;
+	default:
+		key->object = 0;
+		key->detail = event->screen;
+		break;
+	}
+}
 
-		default:
-			DBG(event_type = "(other event)");
-			break;
-		}
+/*
+ * With the line policy, and when the buffer fills up, records are written
+ * while they are appended, not only when the output is flushed
+ */
+static void note_written(void)
+{
+	if (output_written()) {
+		stats_written();
+	}
+}
 
-		DBG(printf("%s\n", event_type));
+/* Report all events of the current burst in a single record */
+static void flush_burst(void)
+{
+	static unsigned long bursts = 0;
+	char vars[2][VAR_SIZE];
+	struct hook_key key;
+
+	if (!burst.received) {
+		return;
 	}
 
+	output_burst(burst.received, burst.events, burst.len);
+	stats_reported();
+	note_written();
+
+	snprintf(vars[0], VAR_SIZE, "XRANDRWAIT_EVENT=burst");
+	snprintf(vars[1], VAR_SIZE, "XRANDRWAIT_EVENTS=%d", burst.received);
+
+	/* Bursts are all about the same object, but never stale */
+	key.display = 0;
+	key.kind = EVENT_TYPES;
+	key.object = 0;
+	key.detail = bursts++;
+	run_hook(&key, vars, 2);
+
+	burst.len = 0;
+	burst.received = 0;
+
 	/* Terminate if we're not in monitor mode */
-	if (handled && !monitor) {
+	if (!monitor) {
 		running = 0;
 	}
-
-	return handled ? 0 : 1;
 }
 
-int main(int argc, char *argv[])
+static void add_to_burst(const struct event *event)
 {
-	struct context ctx;
-	int err;
-	
-	if (parse_cmdline(argc, argv) != 0) {
-		DBG(fprintf(stderr, "Could not parse commandline\n"));
-		return 2;
+	int i;
+
+	for (i = 0; i < burst.len; i++) {
+		if (events_match(&burst.events[i], event)) {
+			break;
+		}
 	}
 
-	setup_signals();
+	if (i == ARRAY_SIZE(burst.events)) {
+		flush_burst();
+		i = 0;
+	}
 
-	if (timeout) {
-		alarm(timeout);
+	if (i == burst.len) {
+		burst.len++;
 	}
 
-	if (!(err = context_open(&ctx))) {
-		struct timespec ts = {
-			.tv_sec = 0,
-			.tv_nsec = 100000000
-		};
-		running = 1;
+	burst.events[i] = *event;
+	burst.received++;
+	burst.deadline = monotonic_ms() + debounce;
+}
 
-		DBG(fprintf(stderr, "Running\n"));
-		
-		while (running) {
-			err = handle_events(&ctx);
-			nanosleep(&ts, NULL);
-		}
-		
-		context_close(&ctx);
+static void report_event(const struct event *event)
+{
+	char vars[MAX_VARS][VAR_SIZE];
+	struct hook_key key;
+
+	if (output_event(event)) {
+		stats_reported();
+		note_written();
+		event_key(event, &key);
+		run_hook(&key, vars, event_vars(event, vars));
 	}
-	
+}
+
+/*
+ * Once the output is full, coalescing events into a burst keeps the most
+ * recent state of each object until the reader catches up
+ */
+static int coalescing(void)
+{
+	return backpressure == BACKPRESSURE_COALESCE && output_blocked();
+}
+
+static void emit_event(const struct event *event)
+{
+	if (debounce || coalescing()) {
+		add_to_burst(event);
+	} else {
+		report_event(event);
+	}
+}
+
+static int next_event(struct context *ctx, struct event *event)
+{
+	if (ctx) {
+		return context_next_event(ctx, event);
+	}
+
+	return replay_path ? trace_replay_next(event) : client_next_event(event);
+}
+
+/* Returns 1 if an event passes the mask, the state, and the filters */
+static int accept_event(const struct event *event)
+{
+	/*
+	 * A server may receive events that weren't asked for, and clients
+	 * receive whatever the server selected.
+	 */
+	if (!(event_map[event->type].mask & (events ? events : DEFAULT_MASK))) {
+		return 0;
+	}
+
+	if (changes_only && !state_update(event)) {
+		DBG(fprintf(stderr, "Suppressing unchanged %s\n",
+			    event_name(event->type)));
+		return 0;
+	}
+
+	names_update(event);
+	monitor_update(event);
+	provider_update(event);
+
+	return filter_match(event);
+}
+
+/* Pass an event through the pipeline. Returns 1 if it was reported */
+static int handle_event(const struct event *event)
+{
+	/* Clients do their own filtering */
+	server_broadcast(event);
+
+	if (!accept_event(event)) {
+		return 0;
+	}
+
+	emit_event(event);
+
+	return 1;
+}
+
+/*
+ * Report a synthetic event from the snapshot taken with --initial. These
+ * describe the baseline rather than a change, so they are neither
+ * debounced nor broadcast, and they don't end the wait for an event.
+ */
+static void handle_initial(const struct event *event, void *data)
+{
+	if (accept_event(event)) {
+		report_event(event);
+	}
+}
+
+static int handle_events(struct context *ctx)
+{
+	unsigned long dropped;
+	struct event event;
+	int received;
+	int recorded;
+	int handled;
+	int err;
+
+	received = 0;
+	recorded = 0;
+	handled = 0;
+
+	while ((err = next_event(ctx, &event)) > 0) {
+		DBG(printf("%s\n", event_name(event.type)));
+		stats_received(&event);
+		received++;
+
+		if (event.type > EVENT_OTHER && event.type < EVENT_TYPES) {
+			trace_record(&event, !recorded++);
+			handled |= handle_event(&event);
+		}
+	}
+
+	stats_batch(received);
+
+	if (ctx && (dropped = context_dropped(ctx)) > 0) {
+		DBG(fprintf(stderr, "Dropped %lu events\n", dropped));
+		stats_dropped(dropped);
+	}
+
+	if (!ctx && replay_path && trace_replay_done()) {
+		DBG(fprintf(stderr, "End of trace. Stopping.\n"));
+		running = 0;
+	}
+
+	if (err < 0) {
+		return err;
+	}
+
+	/*
+	 * Terminate if we're not in monitor mode. When debouncing, this
+	 * happens once the burst has been reported.
+	 */
+	if (handled && !monitor && !debounce) {
+		running = 0;
+	}
+
+	return handled ? 0 : 1;
+}
+
+/*
+ * Block until there is something to do, or until timeout milliseconds
+ * have passed. A negative timeout waits indefinitely.
+ */
+static int wait_events(int timeout)
+{
+	struct pollfd fds[MAX_DISPLAYS + 1 + SERVER_MAX_CLIENTS + 2];
+	char buf[32];
+	int nserver;
+	int nstdout;
+	int err;
+	int i;
+
+	/*
+	 * poll() only sees data that hasn't been read from the socket yet, so
+	 * anything that the backend already queued has to be dispatched first.
+	 */
+	for (i = 0; i < ncontexts; i++) {
+		if (contexts[i] && context_pending(contexts[i])) {
+			return 0;
+		}
+
+		/* Replays and lost displays are woken up by the timeout */
+		if (contexts[i]) {
+			fds[i].fd = context_fd(contexts[i]);
+		} else {
+			fds[i].fd = replay_path || reconnects[i].at ? -1 : client_fd();
+		}
+
+		fds[i].events = POLLIN;
+	}
+
+	nserver = server_pollfds(fds + ncontexts, ARRAY_SIZE(fds) - ncontexts - 2);
+	i = ncontexts + nserver;
+
+	fds[i].fd = signal_pipe[0];
+	fds[i].events = POLLIN;
+	fds[i + 1].revents = 0;
+	nstdout = output_pollfd(&fds[i + 1]);
+
+	if (poll(fds, i + 1 + nstdout, timeout) < 0) {
+		return errno == EINTR ? 0 : -errno;
+	}
+
+	if (fds[i].revents & POLLIN) {
+		while (read(signal_pipe[0], buf, sizeof(buf)) > 0);
+	}
+
+	/* Errors are reported by write() */
+	if (fds[i + 1].revents && (err = output_flush()) < 0) {
+		fprintf(stderr, "Could not write records (%s)\n", strerror(-err));
+		return err;
+	}
+
+	note_written();
+
+	server_handle(fds + ncontexts, nserver);
+
+	/*
+	 * A hangup of a display is reported by the backend when it reads from
+	 * the connection, so that --reconnect can handle it.
+	 */
+	for (i = 0; i < ncontexts; i++) {
+		if (!contexts[i] && !(fds[i].revents & POLLIN) &&
+		    (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			DBG(fprintf(stderr, "Lost connection to the server\n"));
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Query the current configuration of a display for --initial and
+ * --changes-only. With --initial, the snapshot seeds the state through the
+ * pipeline.
+ */
+static void take_snapshot(int i)
+{
+	int err;
+
+	if (!initial && !changes_only) {
+		return;
+	}
+
+	if ((err = context_snapshot(contexts[i], initial ? handle_initial : state_seed,
+				    NULL)) < 0) {
+		fprintf(stderr, "Could not query the current configuration of %s (%s)\n",
+			displays[i], strerror(-err));
+	}
+
+	/* Providers are part of the baseline, but aren't tracked for --changes-only */
+	if (initial && report_providers) {
+		provider_snapshot(i, handle_initial, NULL);
+	}
+}
+
+/* Close the connection to a display and schedule the first attempt to reconnect */
+static void lose_display(int i)
+{
+	fprintf(stderr, "Lost connection to display %s\n", displays[i]);
+
+	context_close(contexts[i]);
+	contexts[i] = NULL;
+
+	reconnects[i].delay = RECONNECT_MIN_MS;
+	reconnects[i].at = monotonic_ms() + reconnects[i].delay;
+}
+
+/*
+ * Try to reconnect to a display, backing off exponentially if that fails.
+ * The new server assigns new XIDs, so everything that is known about the
+ * display is forgotten, and --initial reports the configuration again.
+ */
+static void reconnect_display(int i)
+{
+	const char *name = *displays[i] ? displays[i] : NULL;
+
+	if (context_open(&contexts[i], i, name, event_mask) < 0) {
+		DBG(fprintf(stderr, "Could not reconnect to %s\n", displays[i]));
+
+		if ((reconnects[i].delay *= 2) > RECONNECT_MAX_MS) {
+			reconnects[i].delay = RECONNECT_MAX_MS;
+		}
+
+		reconnects[i].at = monotonic_ms() + reconnects[i].delay;
+		return;
+	}
+
+	fprintf(stderr, "Reconnected to display %s\n", displays[i]);
+	reconnects[i].at = 0;
+
+	names_reset(i, contexts[i]);
+	monitor_reset(i, contexts[i]);
+	provider_reset(i, contexts[i]);
+	state_reset(i);
+	take_snapshot(i);
+}
+
+/*
+ * Servers and traces only name their displays if records are tagged with
+ * their source, so clients and replays do the same.
+ */
+static void use_sources(const char *const *names, int n)
+{
+	for (ndisplays = 0; ndisplays < n; ndisplays++) {
+		displays[ndisplays] = names[ndisplays];
+	}
+
+	if (ndisplays > 0) {
+		tag_sources = 1;
+		output_set_sources(displays, ndisplays);
+	}
+
+	contexts[ncontexts++] = NULL;
+}
+
+/* Connect to a server instead of the X server */
+static int open_client(void)
+{
+	const char *const *names;
+	int err;
+	int n;
+
+	if ((err = client_open(connect_path)) < 0) {
+		fprintf(stderr, "Could not connect to %s (%s)\n",
+			connect_path, strerror(-err));
+		return err;
+	}
+
+	n = client_displays(&names);
+	use_sources(names, n);
+
+	return 0;
+}
+
+/* Read events from a trace instead of the X server */
+static int open_replay(void)
+{
+	const char *const *names;
+	int n;
+
+	if ((n = trace_replay_open(replay_path, replay_speed, &names)) < 0) {
+		fprintf(stderr, "Could not open trace %s (%s)\n",
+			replay_path, strerror(-n));
+		return n;
+	}
+
+	use_sources(names, n);
+
+	return 0;
+}
+
+/*
+ * Connect to all displays. Records are tagged with their origin only if
+ * there is more than one root window to tell apart.
+ */
+static int open_displays(int event_mask)
+{
+	int err;
+
+	if (!ndisplays) {
+		displays[ndisplays++] = NULL;
+	}
+
+	for (ncontexts = 0; ncontexts < ndisplays; ncontexts++) {
+		const char *name = displays[ncontexts];
+
+		if ((err = context_open(&contexts[ncontexts], ncontexts, name, event_mask)) < 0) {
+			fprintf(stderr, "Could not connect to display %s (%s)\n",
+				name ? name : "", strerror(-err));
+
+			while (ncontexts > 0) {
+				context_close(contexts[--ncontexts]);
+			}
+
+			return err;
+		}
+
+		if (!name && !(displays[ncontexts] = getenv("DISPLAY"))) {
+			displays[ncontexts] = "";
+		}
+
+		if (context_screens(contexts[ncontexts]) > 1) {
+			tag_sources = 1;
+		}
+	}
+
+	if (ndisplays > 1) {
+		tag_sources = 1;
+	}
+
+	if (tag_sources) {
+		output_set_sources(displays, ndisplays);
+	}
+
+	return 0;
+}
+
+static void close_displays(void)
+{
+	while (ncontexts > 0) {
+		if (contexts[--ncontexts]) {
+			context_close(contexts[ncontexts]);
+		}
+	}
+
+	client_close();
+	trace_replay_close();
+}
+
+/*
+ * Tell the launcher that events are being waited for. Selecting events
+ * doesn't wait for the X server, so a round trip is made first to be
+ * sure that no change made after the notification can go unnoticed.
+ */
+static void notify_ready(void)
+{
+	int err;
+	int i;
+
+	if (ready_fd < 0 && !notify_socket) {
+		return;
+	}
+
+	for (i = 0; i < ncontexts; i++) {
+		if (contexts[i] && (err = context_sync(contexts[i])) < 0) {
+			/* The main loop reports the lost connection */
+			return;
+		}
+	}
+
+	if ((err = ready_notify(ready_fd, notify_socket)) < 0) {
+		fprintf(stderr, "Could not notify that we are ready (%s)\n", strerror(-err));
+	}
+
+	free(notify_socket);
+	notify_socket = NULL;
+	ready_fd = -1;
+}
+
+/*
+ * Report how long it took from entering main() until events were being
+ * waited for, split into connecting (which includes selecting events)
+ * and setting up everything else, such as taking the snapshot. The
+ * processor time also covers loading and linking the program.
+ */
+static void report_startup(long long started, long long connected, long long ready)
+{
+	struct rusage usage;
+	long long cpu = 0;
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		cpu = (long long)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+			usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+	}
+
+	fprintf(stderr, "startup: connect=%lld us setup=%lld us total=%lld us cpu=%lld us\n",
+		connected - started, ready - connected, ready - started, cpu);
+}
+
+int main(int argc, char *argv[])
+{
+	long long started;
+	int err;
+
+	started = monotonic_us();
+
+	if (parse_cmdline(argc, argv) != 0) {
+		DBG(fprintf(stderr, "Could not parse commandline\n"));
+		return 2;
+	}
+
+	/* Set before any signal handler may clear it */
+	running = 1;
+
+	/*
+	 * Commands started for events, including those of the snapshot, are
+	 * not the service, so the socket is taken out of the environment
+	 * before any of them can be spawned.
+	 */
+	if ((notify_socket = getenv("NOTIFY_SOCKET")) &&
+	    !(notify_socket = strdup(notify_socket))) {
+		fprintf(stderr, "Could not save NOTIFY_SOCKET (%s)\n", strerror(errno));
+	}
+
+	unsetenv("NOTIFY_SOCKET");
+
+	if (collect_stats) {
+		stats_init(stats_path);
+	}
+
+	if ((err = setup_signals()) < 0) {
+		fprintf(stderr, "Could not set up signal handling (%s)\n",
+			strerror(-err));
+		return err;
+	}
+
+	if (nexec && (err = hook_init(exec_cmds, nexec, exec_persistent, exec_jobs)) < 0) {
+		fprintf(stderr, "Invalid command (%s)\n", strerror(-err));
+		return 2;
+	}
+
+	output_init(quiet ? -1 : STDOUT_FILENO, format, flush_policy);
+	output_set_names(resolve_names);
+	output_set_monitors(identify_monitors);
+	output_set_providers(report_providers);
+
+	if ((err = output_set_backpressure(backpressure)) < 0) {
+		fprintf(stderr, "Could not make the output non-blocking (%s)\n",
+			strerror(-err));
+	}
+
+	if (connect_path) {
+		err = open_client();
+	} else if (replay_path) {
+		err = open_replay();
+	} else {
+		/* Clients get what the server selects, on top of the defaults */
+		event_mask = serve_path ? events | DEFAULT_MASK : events ? events : DEFAULT_MASK;
+		err = open_displays(event_mask);
+	}
+
+	if (!err) {
+		long long connected = monotonic_us();
+		long long deadline = 0;
+		long long settle = 0;
+		int status = 1;
+		int i;
+
+		if ((resolve_names || filter_needs_names()) &&
+		    (err = names_init(contexts, ncontexts)) < 0) {
+			fprintf(stderr, "Could not allocate name cache (%s)\n", strerror(-err));
+			resolve_names = 0;
+		}
+
+		if (identify_monitors && (err = monitor_init(contexts, ncontexts)) < 0) {
+			fprintf(stderr, "Could not allocate monitor table (%s)\n", strerror(-err));
+			identify_monitors = 0;
+			output_set_monitors(0);
+		}
+
+		if (report_providers && (err = provider_init(contexts, ncontexts)) < 0) {
+			fprintf(stderr, "Could not allocate provider table (%s)\n", strerror(-err));
+			report_providers = 0;
+			output_set_providers(0);
+		}
+
+		if (changes_only && (err = state_init(ndisplays ? ndisplays : 1)) < 0) {
+			fprintf(stderr, "Could not allocate state (%s)\n", strerror(-err));
+			changes_only = 0;
+		}
+
+		/*
+		 * Events are selected before the snapshot is taken, so that
+		 * no change can slip through between the two.
+		 */
+		for (i = 0; i < ncontexts && contexts[i]; i++) {
+			take_snapshot(i);
+		}
+
+		if (initial) {
+			output_end_batch();
+			note_written();
+		}
+
+		if (serve_path &&
+		    (err = server_init(serve_path, tag_sources ? displays : NULL,
+				       tag_sources ? ndisplays : 0)) < 0) {
+			fprintf(stderr, "Could not listen on %s (%s)\n",
+				serve_path, strerror(-err));
+			running = 0;
+		}
+
+		if (record_path &&
+		    (err = trace_record_open(record_path, tag_sources ? displays : NULL,
+					     tag_sources ? ndisplays : 0)) < 0) {
+			fprintf(stderr, "Could not create trace %s (%s)\n",
+				record_path, strerror(-err));
+			running = 0;
+		}
+
+		/* The time it took to connect doesn't count against the timeout */
+		if (timeout) {
+			deadline = monotonic_ms() + timeout;
+		}
+
+		if (until_stable) {
+			settle = monotonic_ms() + until_stable;
+		}
+
+		if (running) {
+			notify_ready();
+		}
+
+		if (time_startup) {
+			report_startup(started, connected, monotonic_us());
+		}
+
+		DBG(fprintf(stderr, "Running\n"));
+
+		while (running) {
+			long long wait_ms = -1;
+			int handled = 0;
+			long long now;
+
+			for (i = 0; i < ncontexts; i++) {
+				if (reconnects[i].at) {
+					if (reconnects[i].at <= monotonic_ms()) {
+						reconnect_display(i);
+					}
+
+					err = 0;
+					continue;
+				}
+
+				if ((err = handle_events(contexts[i])) < 0) {
+					if (reconnect && contexts[i] && err == -EIO) {
+						lose_display(i);
+						err = 0;
+						continue;
+					}
+
+					break;
+				} else if (err == 0) {
+					status = 0;
+					handled = 1;
+				}
+			}
+
+			if (err < 0) {
+				break;
+			}
+
+			now = monotonic_ms();
+
+			/* Every event that is handled starts the settle time over */
+			if (settle && handled) {
+				settle = now + until_stable;
+			}
+
+			/* While the output is full, the burst waits for it */
+			if (burst.received && !coalescing()) {
+				if (burst.deadline <= now) {
+					flush_burst();
+					continue;
+				}
+
+				wait_ms = burst.deadline - now;
+			}
+
+			if (deadline) {
+				if (deadline <= now) {
+					DBG(fprintf(stderr, "Timeout expired. Stopping.\n"));
+
+					/* The configuration never settled */
+					if (until_stable) {
+						status = 1;
+					}
+
+					running = 0;
+					continue;
+				}
+
+				if (wait_ms < 0 || deadline - now < wait_ms) {
+					wait_ms = deadline - now;
+				}
+			}
+
+			if (settle) {
+				if (settle <= now) {
+					DBG(fprintf(stderr, "Configuration is stable. Stopping.\n"));
+					status = 0;
+					running = 0;
+					continue;
+				}
+
+				if (wait_ms < 0 || settle - now < wait_ms) {
+					wait_ms = settle - now;
+				}
+			}
+
+			for (i = 0; i < ncontexts; i++) {
+				long long left = reconnects[i].at - now;
+
+				if (reconnects[i].at && (wait_ms < 0 || left < wait_ms)) {
+					wait_ms = left > 0 ? left : 0;
+				}
+			}
+
+			if (replay_path) {
+				long long replay_ms = trace_replay_wait();
+
+				if (wait_ms < 0 || replay_ms < wait_ms) {
+					wait_ms = replay_ms;
+				}
+			}
+
+			if ((err = output_end_batch()) < 0) {
+				fprintf(stderr, "Could not write records (%s)\n", strerror(-err));
+				break;
+			}
+
+			note_written();
+			stats_records_dropped(output_dropped());
+			server_flush();
+
+			if (running &&
+			    (err = wait_events(wait_ms > INT_MAX ? INT_MAX : wait_ms)) < 0) {
+				break;
+			}
+
+			stats_wakeup();
+			hook_reap();
+
+			if (dump_stats) {
+				dump_stats = 0;
+				stats_dump();
+			}
+		}
+
+		/* Don't lose events that arrived just before a signal */
+		flush_burst();
+		output_flush();
+		note_written();
+		stats_records_dropped(output_dropped());
+		stats_dump();
+
+		if (err >= 0) {
+			err = status;
+		}
+
+		output_free();
+		trace_record_close();
+		server_free();
+		close_displays();
+		state_free();
+		monitor_free();
+		provider_free();
+		names_free();
+		filter_free();
+	}
+
+	if (nexec) {
+		hook_cleanup();
+	}
+
 	return err;
 }
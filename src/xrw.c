@@ -0,0 +1,210 @@
+/*
+ * xrw.c - Library interface for watching XRandR events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "backend.h"
+#include "xrw.h"
+
+struct handler {
+	xrw_handler *handler;
+	void *data;
+};
+
+struct xrw {
+	struct context *ctx;
+	struct handler handlers[XRW_EVENT_TYPES];
+	struct handler any;
+};
+
+/* Event types are passed through as they are */
+typedef char event_type_check[(int)XRW_EVENT_TYPES == (int)EVENT_TYPES &&
+			      (int)XRW_LEASE == (int)EVENT_LEASE ? 1 : -1];
+
+int xrw_open(struct xrw **xrw, const char *name, int event_mask)
+{
+	struct xrw *x;
+	int err;
+
+	if (!(x = calloc(1, sizeof(*x)))) {
+		return -ENOMEM;
+	}
+
+	if ((err = context_open(&x->ctx, 0, name, event_mask)) < 0) {
+		free(x);
+		return err;
+	}
+
+	*xrw = x;
+
+	return 0;
+}
+
+void xrw_close(struct xrw *xrw)
+{
+	if (xrw) {
+		context_close(xrw->ctx);
+		free(xrw);
+	}
+}
+
+int xrw_set_handler(struct xrw *xrw, int type, xrw_handler *handler, void *data)
+{
+	struct handler *h;
+
+	if (type == XRW_ANY_EVENT) {
+		h = &xrw->any;
+	} else if (type >= 0 && type < XRW_EVENT_TYPES) {
+		h = &xrw->handlers[type];
+	} else {
+		return -EINVAL;
+	}
+
+	h->handler = handler;
+	h->data = data;
+
+	return 0;
+}
+
+int xrw_fd(struct xrw *xrw)
+{
+	return context_fd(xrw->ctx);
+}
+
+int xrw_pending(struct xrw *xrw)
+{
+	return context_pending(xrw->ctx);
+}
+
+/*
+ * struct event is internal to the library, so that it can change without
+ * breaking applications. Events are copied field by field.
+ */
+static void convert(struct xrw_event *dst, const struct event *src)
+{
+	memset(dst, 0, sizeof(*dst));
+	dst->type = src->type;
+	dst->screen = src->screen;
+
+	switch (src->type) {
+	case EVENT_SCREEN_CHANGE:
+		dst->u.screen.timestamp = src->u.screen.timestamp;
+		dst->u.screen.config_timestamp = src->u.screen.config_timestamp;
+		dst->u.screen.width = src->u.screen.width;
+		dst->u.screen.height = src->u.screen.height;
+		dst->u.screen.mwidth = src->u.screen.mwidth;
+		dst->u.screen.mheight = src->u.screen.mheight;
+		dst->u.screen.rotation = src->u.screen.rotation;
+		break;
+
+	case EVENT_CRTC_CHANGE:
+		dst->u.crtc.crtc = src->u.crtc.crtc;
+		dst->u.crtc.mode = src->u.crtc.mode;
+		dst->u.crtc.rotation = src->u.crtc.rotation;
+		dst->u.crtc.x = src->u.crtc.x;
+		dst->u.crtc.y = src->u.crtc.y;
+		dst->u.crtc.width = src->u.crtc.width;
+		dst->u.crtc.height = src->u.crtc.height;
+		break;
+
+	case EVENT_OUTPUT_CHANGE:
+		dst->u.output.output = src->u.output.output;
+		dst->u.output.crtc = src->u.output.crtc;
+		dst->u.output.mode = src->u.output.mode;
+		dst->u.output.rotation = src->u.output.rotation;
+		dst->u.output.connection = src->u.output.connection;
+		break;
+
+	case EVENT_OUTPUT_PROPERTY:
+	case EVENT_PROVIDER_PROPERTY:
+		dst->u.property.xid = src->u.property.xid;
+		dst->u.property.atom = src->u.property.atom;
+		dst->u.property.timestamp = src->u.property.timestamp;
+		dst->u.property.state = src->u.property.state;
+		break;
+
+	case EVENT_PROVIDER_CHANGE:
+		dst->u.provider.provider = src->u.provider.provider;
+		dst->u.provider.timestamp = src->u.provider.timestamp;
+		break;
+
+	case EVENT_RESOURCE_CHANGE:
+		dst->u.resource.timestamp = src->u.resource.timestamp;
+		break;
+
+	case EVENT_LEASE:
+		dst->u.lease.lease = src->u.lease.lease;
+		dst->u.lease.timestamp = src->u.lease.timestamp;
+		dst->u.lease.created = src->u.lease.created;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void deliver(const struct event *event, void *data)
+{
+	struct xrw *xrw = data;
+	struct xrw_event copy;
+	struct handler *h;
+
+	h = event->type >= 0 && event->type < EVENT_TYPES ? &xrw->handlers[event->type] : NULL;
+
+	if (!h || !h->handler) {
+		h = &xrw->any;
+	}
+
+	if (h->handler) {
+		convert(&copy, event);
+		h->handler(&copy, h->data);
+	}
+}
+
+int xrw_dispatch(struct xrw *xrw)
+{
+	struct event event;
+	int dispatched;
+	int err;
+
+	for (dispatched = 0; (err = context_next_event(xrw->ctx, &event)) > 0; dispatched++) {
+		deliver(&event, xrw);
+	}
+
+	return err < 0 ? err : dispatched;
+}
+
+unsigned long xrw_dropped(struct xrw *xrw)
+{
+	return context_dropped(xrw->ctx);
+}
+
+int xrw_snapshot(struct xrw *xrw)
+{
+	return context_snapshot(xrw->ctx, deliver, xrw);
+}
+
+int xrw_output_name(struct xrw *xrw, uint32_t output, char *name, size_t size)
+{
+	return context_output_name(xrw->ctx, output, name, size);
+}
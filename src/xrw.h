@@ -0,0 +1,177 @@
+/*
+ * xrw.h - Library interface for watching XRandR events
+ * Copyright (C) 2025 Matthias Kruk
+ *
+ * Xrandrwait is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 3, or (at your
+ * option) any later version.
+ *
+ * Xrandrwait is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xrandrwait; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XRW_H
+#define XRW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * libxrandrwait lets applications receive the same decoded events as
+ * xrandrwait from their own event loop. A typical loop watches xrw_fd()
+ * for POLLIN and calls xrw_dispatch() whenever it is readable, or when
+ * xrw_pending() says that events are queued already. Nothing blocks, and
+ * no other threads or processes are involved.
+ *
+ * This header is all that applications need; rotations, connection
+ * states, and event masks are the constants from <X11/extensions/randr.h>.
+ */
+
+/* The library is built with hidden visibility, so only this is exported */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define XRW_API __attribute__((visibility("default")))
+#else
+#define XRW_API
+#endif
+
+/* Pass to xrw_set_handler() to handle all events without a handler of their own */
+#define XRW_ANY_EVENT (-1)
+
+enum xrw_event_type {
+	XRW_OTHER = 0,
+	XRW_SCREEN_CHANGE,
+	XRW_CRTC_CHANGE,
+	XRW_OUTPUT_CHANGE,
+	XRW_OUTPUT_PROPERTY,
+	XRW_PROVIDER_CHANGE,
+	XRW_PROVIDER_PROPERTY,
+	XRW_RESOURCE_CHANGE,
+	XRW_LEASE,
+	XRW_EVENT_TYPES
+};
+
+/*
+ * XRandR event, decoded the same way for both backends. XIDs are stored
+ * as they appear on the wire. screen is the screen of the display that
+ * the event was received for.
+ */
+struct xrw_event {
+	int type;
+	uint8_t screen;
+
+	union {
+		struct {
+			uint32_t timestamp;
+			uint32_t config_timestamp;
+			uint16_t width;
+			uint16_t height;
+			uint16_t mwidth;
+			uint16_t mheight;
+			uint16_t rotation;
+		} screen;
+
+		struct {
+			uint32_t crtc;
+			uint32_t mode;
+			uint16_t rotation;
+			int16_t x;
+			int16_t y;
+			uint16_t width;
+			uint16_t height;
+		} crtc;
+
+		struct {
+			uint32_t output;
+			uint32_t crtc;
+			uint32_t mode;
+			uint16_t rotation;
+			uint8_t connection;
+		} output;
+
+		/* Output and provider property events; xid is the owner */
+		struct {
+			uint32_t xid;
+			uint32_t atom;
+			uint32_t timestamp;
+			uint8_t state;
+		} property;
+
+		struct {
+			uint32_t provider;
+			uint32_t timestamp;
+		} provider;
+
+		struct {
+			uint32_t timestamp;
+		} resource;
+
+		struct {
+			uint32_t lease;
+			uint32_t timestamp;
+			uint8_t created;
+		} lease;
+	} u;
+};
+
+struct xrw;
+
+typedef void (xrw_handler)(const struct xrw_event *event, void *data);
+
+/*
+ * Connect to the named display, or $DISPLAY if name is NULL, and select
+ * the XRandR events in event_mask (RR*NotifyMask) on all of its screens.
+ * Returns 0 on success, or a negative error number.
+ */
+XRW_API int xrw_open(struct xrw **xrw, const char *name, int event_mask);
+XRW_API void xrw_close(struct xrw *xrw);
+
+/*
+ * Call handler for events of the given type (XRW_*), or for all other
+ * events if type is XRW_ANY_EVENT. A NULL handler removes the handler.
+ * Returns 0 on success, or -EINVAL if type is invalid.
+ */
+XRW_API int xrw_set_handler(struct xrw *xrw, int type, xrw_handler *handler, void *data);
+
+/* File descriptor to wait on for POLLIN */
+XRW_API int xrw_fd(struct xrw *xrw);
+
+/*
+ * Flush outstanding requests and return 1 if events are queued that
+ * xrw_dispatch() can handle without the descriptor becoming readable.
+ * Call this before blocking on the descriptor.
+ */
+XRW_API int xrw_pending(struct xrw *xrw);
+
+/*
+ * Pass all events that can be read without blocking to their handlers.
+ * The connection is read at most once. Returns the number of events
+ * dispatched, or a negative error number if the connection was lost.
+ * Handlers must not call xrw_close().
+ */
+XRW_API int xrw_dispatch(struct xrw *xrw);
+
+/*
+ * Number of events that were dropped since the last call, because more
+ * events arrived at once than xrw_dispatch() can hold
+ */
+XRW_API unsigned long xrw_dropped(struct xrw *xrw);
+
+/*
+ * Pass the current configuration of all CRTCs and outputs to the handlers
+ * in the form of synthetic events. Returns 0 on success, or a negative
+ * error number.
+ */
+XRW_API int xrw_snapshot(struct xrw *xrw);
+
+/* Store the name of an output in name */
+XRW_API int xrw_output_name(struct xrw *xrw, uint32_t output, char *name, size_t size);
+
+#endif /* XRW_H */